@@ -10,8 +10,11 @@
 #define _BLOCKYCODER_H
 
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 #include "blockypacket.h"
 #include "coder.h"
+#include "threadpool.h"
 
 namespace blocky {
 
@@ -30,9 +33,87 @@ public:
     /*! @brief Stores a packet
         @param[in] packet The packet
         @returns true if the packet was helpful, false otherwise (or on error)
+
+        @see setConcurrentStore
     */
     bool store(BlockyPacket& packet);
 
+    /*! @brief Lets packets be stored from several threads at once
+        @returns true on success, false if packets have already been stored
+
+        Each generation gets its own lock, taken by the store, decode and encode calls
+        that touch it, so packets of different generations are absorbed in parallel and
+        packets of the same generation in turn. Ranks and the number of generations
+        completed are kept in atomics and can be read at any time without locking.
+    */
+    bool setConcurrentStore();
+
+    /*! @brief Get whether packets can be stored from several threads at once
+        @returns Whether setConcurrentStore() or startPipeline() has been called
+    */
+    inline bool getConcurrentStore() { return locks != NULL; }
+
+    /*! @brief Starts decoding and flushing generations in the background as they complete
+        @returns true on success, false if the pipeline is already running
+
+        The store that brings a generation to full rank queues it for a decode thread,
+        which decodes it and queues it for a flush thread. Storing therefore never waits
+        for back substitution or for the output to be synced; packets for a generation
+        that has reached full rank are turned away without waiting for its lock. Each
+        queue holds as many entries as there are generations, so handing off never blocks.
+
+        Stores become concurrent (see setConcurrentStore()). Generations already at full
+        rank are queued straight away, and each generation is queued once. Stores may
+        already be running on other threads only if setConcurrentStore() was called
+        before them. While the pipeline runs, decode(), decodeGeneration(),
+        flush(), flushGeneration() and flushBlock() must not be called.
+
+        @warning The coder must not be moved while the pipeline runs.
+    */
+    bool startPipeline();
+
+    /*! @brief Waits for the pipeline to decode and flush what it has been handed, and stops it
+        @returns true if every generation was decoded and flushed, false otherwise (or if the pipeline is not running)
+
+        Call once no more packets will be stored. An exception thrown by a flush is
+        rethrown here.
+    */
+    bool finishPipeline();
+
+    /*! @brief Get whether the pipeline is running
+        @returns Whether startPipeline() has been called without finishPipeline()
+    */
+    inline bool getPipelined() { return pipeline != NULL; }
+
+    /*! @brief Get the number of generations the pipeline has flushed
+        @returns The number of generations decoded and flushed in the background so far
+    */
+    size_t getGenerationsFlushed();
+
+    /*! @brief Stores a packet, taking ownership of its data if it is kept as received
+        @param[in,out] packet The packet, whose data was allocated with Coder::allocateBlock()
+        @returns true if the packet was helpful, false otherwise (or on error)
+
+        In Coder::DEFERRED and Coder::RECODING modes (the latter is what BlockyCoderRelay
+        uses) the payload of a helpful packet is kept without copying it, and packet.data is
+        set to NULL; the caller supplies a new buffer for the next packet.
+        Otherwise the packet is left as is, and the buffer can be reused.
+
+        @see Coder::store(uint8_t*, uint8_t*, bool&)
+    */
+    bool storeOwned(BlockyPacket& packet);
+
+    /*! @brief Stores several packets
+        @param[in] packets The packets
+        @param[in] count The number of packets
+        @returns The number of helpful packets
+
+        Consecutive packets of the same generation are stored together with
+        Coder::storeBatch, which is much cheaper than storing them one by one.
+        Packets that do not match this coder are skipped.
+    */
+    size_t storeBatch(BlockyPacket *packets, size_t count);
+
     /*! @brief Decodes the given generation
         @param[in] generation The generation to decode
         @returns true if decoding succeeded, false otherwise (or on error)
@@ -41,6 +122,8 @@ public:
 
     /*! @brief Decodes all generations
         @returns true if all the data was decoded, false otherwise (or on error)
+
+        With a thread pool set, generations are decoded in parallel.
     */
     bool decode();
 
@@ -50,9 +133,93 @@ public:
         @returns true on success, false on error
 
         @warning If the packet's data and/or coeffs fields are not null, they must be pointers to arrays of the correct length.
+
+        In seeded mode the packet carries a seed instead of its coefficient vector whenever possible,
+        and coeffs is left untouched.
     */
     bool encode(BlockyPacket& packet, size_t generation);
 
+    /*! @brief Encodes a packet from the given generation using the caller's random number generator
+        @param[in,out] packet The output packet (will be filled in)
+        @param[in] generation The generation to encode a packet from
+        @param[in,out] prng The random number generator to draw coefficients from
+        @returns true on success, false on error
+
+        @warning If the packet's data and/or coeffs fields are not null, they must be pointers to arrays of the correct length.
+
+        Reentrant: any number of threads may encode from the same coder at once, from the
+        same or different generations and without locking, each with its own generator and
+        packets, as long as nothing is stored meanwhile or stores are concurrent (in which
+        case encoding from a generation that is still being decoded waits for its lock;
+        encoders and decoded generations are read without it). Payload work is never striped
+        across the thread pool, which would serialize the callers. Packets are always coded,
+        never systematic. Threads should seed their generators differently, for example from a
+        common seed plus their index. Coders that load generations on demand (see
+        BlockyCoderFile::createStreamingEncoder) do not support this and return false.
+
+        @see Coder::encode(uint8_t*, uint8_t*, PRNG&)
+    */
+    bool encode(BlockyPacket& packet, size_t generation, PRNG& prng) const;
+
+    /*! @brief Encodes several packets from the given generation in one pass
+        @param[in] generation The generation to encode packets from
+        @param[in] count The number of packets to encode
+        @param[in,out] packets The output packets (will be filled in)
+        @returns true on success, false on error
+
+        @warning If the packets' data and/or coeffs fields are not null, they must be pointers to arrays of the correct length.
+
+        Produces the same packets as count calls to encode(), but reads each tile of the
+        generation once for all of them. Coefficient arrays are allocated even for seeded packets.
+
+        @see Coder::encodeBatch
+    */
+    bool encodeBatch(size_t generation, size_t count, BlockyPacket *packets);
+
+    /*! @brief Encodes several packets from every generation
+        @param[in] count The number of packets to encode per generation
+        @param[in,out] packets The output packets, count per generation in order of generation (will be filled in)
+        @returns true on success, false on error
+
+        The same as calling encodeBatch() for each generation, with packets[generation * count]
+        as the first packet of each. With a thread pool set, generations are encoded in parallel,
+        unless they are loaded on demand.
+    */
+    bool encodeGenerations(size_t count, BlockyPacket *packets);
+
+    /*! @brief Sets whether encoded packets carry a seed instead of a coefficient vector
+        @param[in] _seeded Whether to send seeds
+
+        @see Coder::encodeSeeded
+    */
+    inline void setSeeded(bool _seeded) { seeded = _seeded; }
+
+    /*! @brief Get whether encoded packets carry a seed instead of a coefficient vector
+        @returns Whether seeds are sent
+    */
+    inline bool getSeeded() { return seeded; }
+
+    /*! @brief Seeds the coefficient generators of all generations
+        @param[in] seed The seed
+
+        Makes encoding reproducible; each generation derives its own seed from the given one.
+    */
+    void setSeed(uint64_t seed);
+
+    /*! @brief Sets whether encoding is systematic for all generations
+        @param[in] systematic Whether to send each generation's original blocks before coded ones
+
+        @see Coder::setSystematic
+    */
+    void setSystematic(bool systematic);
+
+    /*! @brief Sets the number of nonzero coefficients in each encoded block for all generations
+        @param[in] nonzeros The number of source blocks combined, 0 for all of them
+
+        @see Coder::setNonzeros
+    */
+    void setNonzeros(size_t nonzeros);
+
     /*! @brief Flushes the decoded data to the output
         @param[in] generation The generation to flush
         @returns true on success, false on error
@@ -61,9 +228,45 @@ public:
 
     /*! @brief Flushes all generations to the output
         @returns true on success, false on error
+
+        With a thread pool set, generations are flushed in parallel where the output allows it.
     */
     bool flush();
 
+    /*! @brief Flushes a single decoded block to the output
+        @param[in] generation The generation
+        @param[in] block The block within the generation
+        @returns true on success, false on error (or if the block has not been decoded yet)
+
+        Together with Coder::GAUSS_JORDAN decoding, this lets blocks be released as soon as
+        they are decoded instead of when their whole generation is.
+    */
+    virtual bool flushBlock(size_t generation, size_t block);
+
+    /*! @brief Sets the thread pool that work over all generations runs on
+        @param[in] _pool The pool, NULL to run serially
+
+        Generations are independent, so decode(), flush() and encodeGenerations() hand one
+        task per generation to the pool. With fewer generations than threads, they are instead
+        processed in turn with the payload work of each striped across the pool. The pool is
+        not owned and must outlive its use.
+
+        @see ThreadPool::getDefault
+        @see Coder::setThreadPool
+    */
+    void setThreadPool(ThreadPool *_pool);
+
+    /*! @brief Get the thread pool that work over all generations runs on
+        @returns The pool, NULL if work runs serially
+    */
+    inline ThreadPool *getThreadPool() { return pool; }
+
+    /*! @brief Sets the decoding strategy for all generations
+        @param[in] mode The decoding mode
+        @returns true on success, false if packets have already been stored
+    */
+    bool setDecodingMode(Coder::DecodingMode mode);
+
     /*! @brief Get the block size
         @returns The block size
     */
@@ -112,6 +315,9 @@ public:
 
     /*! @brief Get the underlying buffer
         @returns The underlying buffer
+
+        In a decoder, only the generations decoded so far hold valid data; the rest of the
+        buffer may be uninitialized.
     */
     inline uint8_t *getBuffer() { return buffer; }
 
@@ -129,13 +335,13 @@ public:
         @param[in] generation The generation
         @returns The rank of the given generation
     */
-    inline size_t getRank(size_t generation) { return coders[generation].getRank(); }
+    inline size_t getRank(size_t generation) { return ranks ? ranks[generation].load() : coders[generation].getRank(); }
 
     /*! @brief Get whether it is possible to decode the given generation
         @param[in] generation The generation
         @returns Whether it is possible to decode the given generation
     */
-    inline bool canDecodeGeneration(size_t generation) { return coders[generation].canDecode(); }
+    inline bool canDecodeGeneration(size_t generation) { return getRank(generation) == coders[generation].getNumBlocks(); }
 
     /*! @brief Get whether the data has been decoded
         @returns Whether the data has been decoded
@@ -148,6 +354,19 @@ public:
     */
     inline bool getGenerationDecoded(size_t generation) { return coders[generation].getDecoded(); }
 
+    /*! @brief Get whether the given block has been decoded
+        @param[in] generation The generation
+        @param[in] block The block within the generation
+        @returns Whether the given block has been decoded
+    */
+    inline bool getBlockDecoded(size_t generation, size_t block) { return coders[generation].isBlockDecoded(block); }
+
+    /*! @brief Get whether the data of a generation is held in memory
+        @param[in] generation The generation
+        @returns Whether the generation's blocks are in memory, always true unless the coder holds generations on demand
+    */
+    virtual bool getGenerationResident(size_t generation) { (void) generation; return true; }
+
 protected:
 
     /*! @brief Default constructor */
@@ -192,6 +411,84 @@ protected:
     /*! @brief Creates a set of decoders over the blocks */
     void createDecoders();
 
+    /*! @brief Creates a set of recoders holding their own blocks
+
+        @see Coder::createRecoder
+    */
+    void createRecoders();
+
+    /*! @brief Runs body(generation) for every generation, on the thread pool if there is one
+        @param[in] body The work for one generation
+        @returns true if body returned true for every generation
+    */
+    bool forEachGeneration(const std::function<bool(size_t)>& body);
+
+    /*! @brief Get whether different generations can be flushed at the same time
+        @returns Whether flushGeneration() may run concurrently for different generations
+    */
+    virtual bool canFlushConcurrently() { return true; }
+
+    /*! @brief Makes the data of a generation available to its coder before encoding from it
+        @param[in] generation The generation
+        @returns true on success, false on error
+    */
+    virtual bool loadGeneration(size_t generation) { (void) generation; return true; }
+
+    /*! @brief Get whether different generations can be encoded from at the same time
+        @returns Whether encoding from one generation leaves the data of the others in place
+    */
+    virtual bool canEncodeConcurrently() const { return true; }
+
+    /*! @brief Prepares the storage of a generation before the first packet is stored in it
+        @param[in] generation The generation, which has rank 0
+
+        Called with the generation locked. Lets decoders commit memory to the generations
+        in flight only, rather than to all the data up front.
+    */
+    virtual void allocateGeneration(size_t generation) { (void) generation; }
+
+    /*! @brief Locks a generation if packets may be stored concurrently
+        @param[in] generation The generation
+        @returns The lock, which owns nothing if stores are not concurrent
+    */
+    std::unique_lock<std::mutex> lockGeneration(size_t generation) const;
+
+    /*! @brief Publishes the rank of a generation after a store, with its lock held
+        @param[in] generation The generation
+        @param[in] helpful Whether the store raised the rank
+
+        Hands the generation to the pipeline, if it is running, once the rank is full.
+    */
+    void updateRank(size_t generation, bool helpful);
+
+    /*! @brief Get whether a generation is known to be at full rank, without locking it
+        @param[in] generation The generation
+        @returns Whether stores are concurrent and the generation's published rank is full
+    */
+    inline bool isGenerationFull(size_t generation) { return ranks && ranks[generation] == coders[generation].getNumBlocks(); }
+
+    /*! @brief Get whether a generation's blocks can no longer change, without locking it
+        @param[in] generation The generation
+        @returns Whether stores are concurrent and the generation is an encoder's or has been decoded
+    */
+    inline bool isGenerationSettled(size_t generation) const { return settled && settled[generation]; }
+
+    /*! @brief Creates the per-generation locks and ranks, starting from the current ranks */
+    void createLocks();
+
+    /*! @brief Stops the pipeline if it is running, ignoring any errors
+
+        Derived classes call this first thing in their destructors, since the pipeline
+        calls their flushGeneration().
+    */
+    void stopPipeline();
+
+    /*! @brief Checks that a packet belongs to this coder
+        @param[in] packet The packet
+        @returns Whether the packet's generation exists and its dimensions match it
+    */
+    bool checkPacket(const BlockyPacket& packet);
+
     /*! @brief The block size */
     size_t blockSize;
 
@@ -219,6 +516,9 @@ protected:
     /*! @brief Whether the last generation is partial */
     bool partialLastGeneration;
 
+    /*! @brief Whether encoded packets carry seeds instead of coefficient vectors */
+    bool seeded;
+
     /*! @brief The array of blocks */
     uint8_t **blocks;
 
@@ -230,6 +530,24 @@ protected:
         @see Coder
     */
     Coder *coders;
+
+    /*! @brief The thread pool for work over all generations, NULL to run serially */
+    ThreadPool *pool;
+
+    /*! @brief One lock per generation, NULL unless stores are concurrent */
+    std::mutex *locks;
+
+    /*! @brief The rank of each generation, NULL unless stores are concurrent */
+    std::atomic<size_t> *ranks;
+
+    /*! @brief Whether each generation is settled (see isGenerationSettled()), NULL unless stores are concurrent */
+    std::atomic<bool> *settled;
+
+    /*! @brief The background decode and flush stages */
+    struct Pipeline;
+
+    /*! @brief The running pipeline, NULL if there is none; read by stores on other threads */
+    std::atomic<Pipeline *> pipeline;
 };
 
 }
@@ -9,6 +9,7 @@
 #ifndef _BLOCKYCODERFILE_H
 #define _BLOCKYCODERFILE_H
 
+#include <atomic>
 #include <cstdio>
 #include <exception>
 #include <system_error>
@@ -27,6 +28,14 @@ class BlockyCoderFile : public BlockyCoder {
 
 public:
 
+    /*! @brief When flushed generations are made durable */
+    enum SyncMode {
+        NO_SYNC,        /*!< Never; the data reaches the disk when the kernel writes it back */
+        SYNC_EVERY,     /*!< After every interval generations flushed */
+        SYNC_GROUP,     /*!< Every interval milliseconds, if anything was flushed meanwhile, from a background thread */
+        SYNC_ON_CLOSE   /*!< Once, when the coder is destroyed */
+    };
+
     /*! @brief Default constructor */
     BlockyCoderFile();
 
@@ -49,27 +58,142 @@ public:
     */
     static BlockyCoderFile createEncoder(size_t _blockSize, size_t _blocksPerGeneration, string _filePath);
 
+    /*! @brief Creates an encoder that reads generations from the file as they are needed
+        @param[in] _blockSize The block size
+        @param[in] _blocksPerGeneration The number of blocks per generation
+        @param[in] _filePath The path of the file to encode
+        @param[in] _windowSize The number of generations held in memory at once
+
+        Instead of reading the whole file up front, a generation is read when a packet is
+        first encoded from it, into the window slot of the least recently used generation.
+        The kernel is asked to read ahead the generations that follow, so encoding through
+        the file in order rarely waits on the disk. Memory for data stays at _windowSize
+        generations regardless of the file size, and the first packet costs one generation
+        of I/O.
+
+        Encoding from several threads with encode(BlockyPacket&, size_t, PRNG&) is not
+        supported, and encodeGenerations() works through the generations in turn.
+    */
+    static BlockyCoderFile createStreamingEncoder(size_t _blockSize, size_t _blocksPerGeneration, string _filePath, size_t _windowSize);
+
     /*! @brief Creates a decoder
         @param[in] _blockSize The block size
         @param[in] _blocksPerGeneration The number of blocks per generation
         @param[in] _dataLength The length of the incoming data file
         @param[in] _filePath The path of the file to store decoded data in
+
+        As with BlockyCoderMemory::createDecoder(), a generation's part of the buffer is
+        cleared when its first packet arrives, so only decoded generations hold valid data.
     */
     static BlockyCoderFile createDecoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength, string _filePath);
 
+    /*! @brief Creates a decoder that only holds the generations in flight
+        @param[in] _blockSize The block size
+        @param[in] _blocksPerGeneration The number of blocks per generation
+        @param[in] _dataLength The length of the incoming data file
+        @param[in] _filePath The path of the file to store decoded data in
+
+        A generation's storage is allocated when its first packet arrives, and released
+        once flushGeneration() has written it out. Memory then follows the number of
+        generations being received rather than the file size. There is no buffer
+        (getBuffer() returns NULL); the decoded data is only in the file, and flushed
+        generations can no longer be encoded from.
+    */
+    static BlockyCoderFile createStreamingDecoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength, string _filePath);
+
     /*! @brief Get the file path
         @returns The file path
     */
     inline string getFilePath() { return filePath; }
 
+    /*! @brief Get the number of generations held in memory at once
+        @returns The window size, 0 if the whole file is held in memory
+    */
+    inline size_t getWindowSize() { return windowSize; }
+
+    /*! @brief Get whether the data of a generation is held in memory
+        @param[in] generation The generation
+        @returns Whether the generation is in the window of a streaming encoder, or allocated and not yet flushed in a streaming decoder
+    */
+    bool getGenerationResident(size_t generation);
+
     /*! @brief Flushes the decoded data to the output
         @param[in] generation The generation to flush
         @returns true on success, false on error
+
+        Writes the generation with a positional write, so different generations can be
+        flushed at the same time, and makes it durable as the sync mode says.
+
+        @see setSyncMode
     */
     bool flushGeneration(size_t generation);
 
+    /*! @brief Sets when flushed generations are made durable
+        @param[in] _syncMode The sync mode
+        @param[in] _syncInterval The number of generations between syncs for #SYNC_EVERY, or the milliseconds between them for #SYNC_GROUP
+
+        The default is #SYNC_EVERY generation, so a flushed generation is on disk when
+        flushGeneration() returns. Anything but #NO_SYNC also syncs what is left when the
+        coder is destroyed; call sync() first to find out whether that succeeded.
+    */
+    void setSyncMode(SyncMode _syncMode, size_t _syncInterval = 1);
+
+    /*! @brief Get when flushed generations are made durable
+        @returns The sync mode
+    */
+    inline SyncMode getSyncMode() { return syncMode; }
+
+    /*! @brief Get the interval between syncs
+        @returns The number of generations or milliseconds between syncs, depending on the sync mode
+    */
+    inline size_t getSyncInterval() { return syncInterval; }
+
+    /*! @brief Makes everything flushed so far durable
+        @returns true on success
+
+        Throws if this or an earlier background sync failed.
+    */
+    bool sync();
+
+    /*! @brief Sets whether the file is read and written asynchronously through io_uring
+        @param[in] enabled Whether to use asynchronous I/O
+        @returns true if I/O is now as asked, false if io_uring is not available here (I/O stays synchronous)
+
+        A streaming encoder queues reads for the generations after the one being encoded
+        into free window slots, and only waits for a generation's read when it is first
+        encoded from; its window is registered with the kernel if the locked memory limit
+        allows. A decoder queues the write of each flushed generation and returns, so
+        decoding carries on while the disk works; a streaming decoder releases the
+        generation once its write completes. Completed writes are collected by later
+        flushes, and sync() and destruction wait for all of them, so the sync modes make
+        the same promises as before (with #SYNC_EVERY generation, every flush waits).
+        Failed writes are thrown by a later flushGeneration() or sync().
+
+        Generations are then flushed one at a time. Call it before encoding, storing or
+        starting the pipeline.
+    */
+    bool setAsyncIO(bool enabled);
+
+    /*! @brief Get whether the file is read and written asynchronously
+        @returns Whether asynchronous I/O is on
+    */
+    inline bool getAsyncIO() { return asyncIO != NULL; }
+
+    /*! @brief Flushes a single decoded block to the output
+        @param[in] generation The generation
+        @param[in] block The block within the generation
+        @returns true on success, false if the block has not been decoded yet
+    */
+    bool flushBlock(size_t generation, size_t block);
+
 protected:
 
+    /*! @brief How a streaming coder holds its generations in memory */
+    enum StreamingMode {
+        WINDOWED,       /*!< An encoder keeping a window of generations, read from the file as needed */
+        ON_ARRIVAL      /*!< A decoder allocating each generation when its first packet arrives */
+    };
+
     /*! @brief Base constructor
         @param[in] _blockSize The block size
         @param[in] _blocksPerGeneration The number of blocks per generation
@@ -78,6 +202,16 @@ protected:
     */
     BlockyCoderFile(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength, string _filePath);
 
+    /*! @brief Streaming constructor
+        @param[in] _blockSize The block size
+        @param[in] _blocksPerGeneration The number of blocks per generation
+        @param[in] _dataLength The data length
+        @param[in] _filePath The file path
+        @param[in] _streamingMode How generations are held in memory
+        @param[in] _windowSize The number of generations held in memory at once, at least 1; only used when #WINDOWED
+    */
+    BlockyCoderFile(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength, string _filePath, StreamingMode _streamingMode, size_t _windowSize = 1);
+
     /*! @brief Copy constructor */
     BlockyCoderFile(const BlockyCoderFile& other) = delete;
 
@@ -87,6 +221,81 @@ protected:
     */
     void swap(BlockyCoderFile& first, BlockyCoderFile& second);
 
+    /*! @brief Get whether different generations can be flushed at the same time
+        @returns false with asynchronous I/O, whose ring is fed from one thread at a time
+    */
+    bool canFlushConcurrently() { return asyncIO == NULL; }
+
+    /*! @brief Reads a generation into the window if it is not there already
+        @param[in] generation The generation
+        @returns true on success, false if the generation does not exist (or, in a streaming decoder, is not held)
+    */
+    bool loadGeneration(size_t generation);
+
+    /*! @brief Get whether different generations can be encoded from at the same time
+        @returns false for a streaming coder, since generations come and go from memory
+    */
+    bool canEncodeConcurrently() const { return windowSize == 0 && generationBuffers == NULL; }
+
+    /*! @brief Prepares the storage of a generation before its first packet is stored
+        @param[in] generation The generation
+
+        Clears its part of the buffer, or allocates it in a streaming decoder.
+    */
+    void allocateGeneration(size_t generation);
+
+    /*! @brief Reads from the file at an offset, without moving the stream
+        @param[out] data The destination (will be filled in)
+        @param[in] length The number of bytes to read
+        @param[in] offset The offset in the file
+    */
+    void readAt(uint8_t *data, size_t length, size_t offset);
+
+    /*! @brief Writes to the file at an offset, without moving the stream
+        @param[in] data The source
+        @param[in] length The number of bytes to write
+        @param[in] offset The offset in the file
+    */
+    void writeAt(const uint8_t *data, size_t length, size_t offset);
+
+    /*! @brief Get the least recently used window slot that can be read into
+        @param[in] first The first generation to keep
+        @param[in] last One past the last generation to keep
+        @returns The slot, or windowSize if every slot holds a generation to keep or a read in flight
+    */
+    size_t leastRecentSlot(size_t first, size_t last);
+
+    /*! @brief Queues reads for the generations after one into free window slots
+        @param[in] generation The generation being encoded from
+    */
+    void readAhead(size_t generation);
+
+    /*! @brief Finishes an asynchronous read or write
+        @param[in] tag The tag of the request
+        @param[in] result The number of bytes transferred, or a negated errno
+    */
+    void completeIO(uint64_t tag, int result);
+
+    /*! @brief Finishes the asynchronous requests that have completed, without waiting */
+    void pollIO();
+
+    /*! @brief Waits for an asynchronous request to complete and finishes it
+        @returns true if one was finished, false if none is in flight
+    */
+    bool waitIO();
+
+    /*! @brief Waits for every asynchronous request in flight */
+    void drainIO();
+
+    /*! @brief Throws the first asynchronous write error not reported yet, if any */
+    void throwIOError();
+
+    /*! @brief Syncs after a generation has been written, if the sync mode calls for it */
+    void syncFlushed();
+
+    /*! @brief Stops the background sync, if any, and syncs what is left unless the sync mode is #NO_SYNC, ignoring errors */
+    void syncOnClose();
+
     /*! @brief The file path */
     string filePath;
 
@@ -96,6 +305,45 @@ protected:
     /*! @brief The file descriptor */
     int fd;
 
+    /*! @brief The number of generations held in memory at once, 0 if the whole file is */
+    size_t windowSize;
+
+    /*! @brief The blocks of each window slot, blocksPerGeneration per slot */
+    uint8_t **window;
+
+    /*! @brief The generation held by each window slot, numGenerations if none */
+    size_t *slotGenerations;
+
+    /*! @brief When each window slot was last used, 0 if never */
+    size_t *slotTimes;
+
+    /*! @brief The number of window lookups so far, which times slot use */
+    size_t windowClock;
+
+    /*! @brief The storage of each generation in a streaming decoder, NULL where not allocated or already flushed */
+    uint8_t **generationBuffers;
+
+    /*! @brief When flushed generations are made durable */
+    SyncMode syncMode;
+
+    /*! @brief The number of generations or milliseconds between syncs */
+    size_t syncInterval;
+
+    /*! @brief The number of generations flushed since the last sync */
+    std::atomic<size_t> unsynced;
+
+    /*! @brief The background sync of #SYNC_GROUP */
+    struct SyncTimer;
+
+    /*! @brief The running background sync, NULL if there is none */
+    SyncTimer *syncTimer;
+
+    /*! @brief The io_uring and the state of its requests */
+    struct AsyncIO;
+
+    /*! @brief The asynchronous I/O, NULL if I/O is synchronous */
+    AsyncIO *asyncIO;
+
 };
 
 }
@@ -48,6 +48,11 @@ public:
         @param[in] _blockSize The block size
         @param[in] _blocksPerGeneration The number of blocks per generation
         @param[in] _dataLength The length of the data to decode
+
+        A generation's part of the buffer is only cleared when its first packet arrives,
+        so the pages of a large buffer are committed as generations come in, not up front.
+        Only decoded generations hold valid data; the bytes of a generation that never
+        received a packet are uninitialized, not zero.
     */
     static BlockyCoderMemory createDecoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength);
 
@@ -69,6 +74,11 @@ protected:
     */
     void swap(BlockyCoderMemory& first, BlockyCoderMemory& second);
 
+    /*! @brief Clears a generation's part of the buffer before its first packet is stored
+        @param[in] generation The generation
+    */
+    void allocateGeneration(size_t generation);
+
 };
 
 }
@@ -68,6 +68,13 @@ public:
     */
     bool flushGeneration(size_t generation);
 
+    /*! @brief Flushes a single decoded block to the output
+        @param[in] generation The generation
+        @param[in] block The block within the generation
+        @returns true on success, false if the block has not been decoded yet
+    */
+    bool flushBlock(size_t generation, size_t block);
+
 protected:
 
     /*! @brief Base constructor
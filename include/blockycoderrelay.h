@@ -0,0 +1,73 @@
+/*!
+    @file
+    @brief BlockyCoderRelay
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#ifndef _BLOCKYCODERRELAY_H
+#define _BLOCKYCODERRELAY_H
+
+#include "blockycoder.h"
+
+namespace blocky {
+
+/*! @brief Network Coding Operations at an Intermediate Node
+
+    Stores packets as received and forwards fresh combinations of them, without decoding.
+    Each generation can be recoded as soon as it has rank one, and an outgoing packet costs
+    one pass over the blocks held for its generation. There is no buffer, and decode() and
+    decodeGeneration() always fail.
+
+    @see Coder::RECODING
+*/
+class BlockyCoderRelay : public BlockyCoder {
+
+public:
+
+    /*! @brief Default constructor */
+    BlockyCoderRelay();
+
+    /*! @brief Move constructor */
+    BlockyCoderRelay(BlockyCoderRelay&& other);
+
+    /*! @brief Destructor */
+    ~BlockyCoderRelay();
+
+    /*! @brief Assignment operator */
+    BlockyCoderRelay& operator=(BlockyCoderRelay& other);
+
+    /*! @brief Move operator */
+    BlockyCoderRelay& operator=(BlockyCoderRelay&& other);
+
+    /*! @brief Creates a relay
+        @param[in] _blockSize The block size
+        @param[in] _blocksPerGeneration The number of blocks per generation
+        @param[in] _dataLength The length of the data being relayed
+    */
+    static BlockyCoderRelay createRelay(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength);
+
+protected:
+
+    /*! @brief Base constructor
+        @param[in] _blockSize The block size
+        @param[in] _blocksPerGeneration The number of blocks per generation
+        @param[in] _dataLength The data length
+    */
+    BlockyCoderRelay(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength);
+
+    /*! @brief Copy constructor */
+    BlockyCoderRelay(const BlockyCoderRelay& other) = delete;
+
+    /*! @brief Swaps two BlockyCoderRelay objects
+        @param[in,out] first The first BlockyCoderRelay
+        @param[in,out] second The second BlockyCoderRelay
+    */
+    void swap(BlockyCoderRelay& first, BlockyCoderRelay& second);
+
+};
+
+}
+
+#endif
@@ -0,0 +1,258 @@
+/*!
+    @file
+    @brief BlockyCoderStream
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#ifndef _BLOCKYCODERSTREAM_H
+#define _BLOCKYCODERSTREAM_H
+
+#include <cstdlib>
+#include <cstring>
+#include "blockypacket.h"
+#include "coder.h"
+
+namespace blocky {
+
+/*! @brief Network Coding Operations over a Stream of Unknown Length
+
+    Unlike BlockyCoder, the number of generations is not fixed. The encoder takes data as
+    it is appended and seals a generation whenever one fills up; the decoder starts on a
+    generation the first time one of its packets arrives and retires it once it has been
+    delivered. Both hold a fixed window of generations in memory, allocated up front, so
+    memory and latency stay constant however long the stream runs.
+
+    Each generation ends with the number of data bytes it holds, so the decoder delivers
+    exactly what was appended: a generation holds getGenerationCapacity() bytes, and one
+    sealed early with seal() has only as many blocks as its data and length need.
+*/
+class BlockyCoderStream {
+
+public:
+
+    /*! @brief Default constructor */
+    BlockyCoderStream();
+
+    /*! @brief Copy constructor */
+    BlockyCoderStream(const BlockyCoderStream& other) = delete;
+
+    /*! @brief Move constructor */
+    BlockyCoderStream(BlockyCoderStream&& other);
+
+    /*! @brief Destructor */
+    ~BlockyCoderStream();
+
+    /*! @brief Assignment operator */
+    BlockyCoderStream& operator=(BlockyCoderStream& other);
+
+    /*! @brief Move operator */
+    BlockyCoderStream& operator=(BlockyCoderStream&& other);
+
+    /*! @brief Creates an encoder
+        @param[in] _blockSize The block size
+        @param[in] _blocksPerGeneration The number of blocks per generation
+        @param[in] _windowSize The number of sealed generations that can still be encoded from
+
+        Sealing a generation drops the oldest one from the window once it is full.
+    */
+    static BlockyCoderStream createEncoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _windowSize);
+
+    /*! @brief Creates a decoder
+        @param[in] _blockSize The block size
+        @param[in] _blocksPerGeneration The number of blocks per generation
+        @param[in] _windowSize The number of generations that can be in flight at once
+
+        Packets for generations beyond the window are turned away until the oldest
+        generation has been delivered (or skipped).
+    */
+    static BlockyCoderStream createDecoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _windowSize);
+
+    /*! @brief Appends data to the stream
+        @param[in] data The data
+        @param[in] length The length of the data
+        @returns The number of generations sealed, or 0 if this is not an encoder
+    */
+    size_t append(const uint8_t *data, size_t length);
+
+    /*! @brief Seals the generation being filled, even if it is not full
+        @returns true if a generation was sealed, false if there was no data to seal (or this is not an encoder)
+    */
+    bool seal();
+
+    /*! @brief Encodes a packet from the given generation
+        @param[in,out] packet The output packet (will be filled in)
+        @param[in] generation The generation to encode a packet from
+        @returns true on success, false if the generation is not sealed or has left the window
+
+        @warning If the packet's data and/or coeffs fields are not null, they must be pointers to arrays of the correct length.
+
+        @see BlockyCoder::encode
+    */
+    bool encode(BlockyPacket& packet, size_t generation);
+
+    /*! @brief Stores a packet
+        @param[in] packet The packet
+        @returns true if the packet was helpful, false otherwise (or if its generation is outside the window)
+
+        The first packet of a generation sets its number of blocks.
+    */
+    bool store(BlockyPacket& packet);
+
+    /*! @brief Decodes and retires the oldest generation in flight, if it is complete
+        @param[out] length The length of the decoded data, exactly as appended
+        @returns The decoded data, NULL if the oldest generation cannot be decoded yet
+
+        The data stays valid until the next call to store(), deliver() or skipTo().
+        Generations are delivered in order.
+    */
+    const uint8_t *deliver(size_t& length);
+
+    /*! @brief Gives up on every generation before the given one
+        @param[in] generation The generation to deliver next
+        @returns true on success, false if this is not a decoder or the generation is behind the window
+
+        Lets a live stream move past generations that will not complete in time.
+    */
+    bool skipTo(size_t generation);
+
+    /*! @brief Sets whether encoded packets carry a seed instead of a coefficient vector
+        @param[in] _seeded Whether to send seeds
+
+        @see Coder::encodeSeeded
+    */
+    inline void setSeeded(bool _seeded) { seeded = _seeded; }
+
+    /*! @brief Get whether encoded packets carry a seed instead of a coefficient vector
+        @returns Whether seeds are sent
+    */
+    inline bool getSeeded() { return seeded; }
+
+    /*! @brief Sets whether encoding is systematic for generations sealed from now on
+        @param[in] _systematic Whether to send each generation's original blocks before coded ones
+
+        @see Coder::setSystematic
+    */
+    inline void setSystematic(bool _systematic) { systematic = _systematic; }
+
+    /*! @brief Sets the decoding strategy for generations started from now on
+        @param[in] _mode The decoding mode
+
+        @see Coder::setDecodingMode
+    */
+    inline void setDecodingMode(Coder::DecodingMode _mode) { mode = _mode; }
+
+    /*! @brief Get the block size
+        @returns The block size
+    */
+    inline size_t getBlockSize() { return blockSize; }
+
+    /*! @brief Get the number of blocks per generation
+        @returns The number of blocks per generation
+    */
+    inline size_t getBlocksPerGeneration() { return blocksPerGeneration; }
+
+    /*! @brief Get the number of data bytes a generation holds
+        @returns The size of a generation less the length it carries
+    */
+    inline size_t getGenerationCapacity() { return (blocksPerGeneration * blockSize) - LENGTH_SIZE; }
+
+    /*! @brief Get the window size
+        @returns The number of generations the window holds
+    */
+    inline size_t getWindowSize() { return windowSize; }
+
+    /*! @brief Get the oldest generation in the window
+        @returns The oldest generation an encoder can encode from, or the next generation a decoder delivers
+    */
+    inline size_t getFirstGeneration() { return firstGeneration; }
+
+    /*! @brief Get the generation being filled
+        @returns The generation the next appended data goes into, which is also the number of generations sealed so far
+    */
+    inline size_t getNextGeneration() { return nextGeneration; }
+
+    /*! @brief Get the rank of a generation in flight
+        @param[in] generation The generation
+        @returns The rank, 0 if the generation has not been started or is outside the window
+    */
+    size_t getRank(size_t generation);
+
+protected:
+
+    /*! @brief Base constructor
+        @param[in] _blockSize The block size
+        @param[in] _blocksPerGeneration The number of blocks per generation
+        @param[in] _windowSize The window size
+        @param[in] _numSlots The number of generations held in memory
+    */
+    BlockyCoderStream(size_t _blockSize, size_t _blocksPerGeneration, size_t _windowSize, size_t _numSlots);
+
+    /*! @brief Swaps two BlockyCoderStream objects
+        @param[in,out] first The first BlockyCoderStream
+        @param[in,out] second The second BlockyCoderStream
+    */
+    void swap(BlockyCoderStream& first, BlockyCoderStream& second);
+
+    /*! @brief Get the slot holding a generation
+        @param[in] generation The generation
+        @returns The slot
+    */
+    inline size_t getSlot(size_t generation) { return generation % numSlots; }
+
+    /*! @brief The block size */
+    size_t blockSize;
+
+    /*! @brief The number of blocks per generation */
+    size_t blocksPerGeneration;
+
+    /*! @brief The window size */
+    size_t windowSize;
+
+    /*! @brief The number of slots, one more than the window for an encoder to fill the next generation in */
+    size_t numSlots;
+
+    /*! @brief Whether this is an encoder */
+    bool encoding;
+
+    /*! @brief Whether encoded packets carry seeds instead of coefficient vectors */
+    bool seeded;
+
+    /*! @brief Whether generations sealed from now on are encoded systematically */
+    bool systematic;
+
+    /*! @brief The decoding mode of generations started from now on */
+    Coder::DecodingMode mode;
+
+    /*! @brief The oldest generation in the window */
+    size_t firstGeneration;
+
+    /*! @brief The generation being filled by an encoder */
+    size_t nextGeneration;
+
+    /*! @brief The number of bytes in the generation being filled */
+    size_t fill;
+
+    /*! @brief The storage of the slots, blocksPerGeneration blocks each */
+    uint8_t *buffer;
+
+    /*! @brief The blocks of the slots */
+    uint8_t **blocks;
+
+    /*! @brief The coder of each slot */
+    Coder *coders;
+
+    /*! @brief The generation held by each slot, or #NO_GENERATION */
+    size_t *slotGenerations;
+
+    /*! @brief Marks a slot that holds no generation */
+    static const size_t NO_GENERATION = (size_t) -1;
+
+    /*! @brief The size of the length at the end of each generation, stored little endian */
+    static const size_t LENGTH_SIZE = 4;
+};
+
+}
+
+#endif
@@ -9,6 +9,9 @@
 #ifndef _BLOCKYPACKET_H
 #define _BLOCKYPACKET_H
 
+#include <cstddef>
+#include <cstdint>
+
 namespace blocky {
 
 /*! @brief Network Coded Packet */
@@ -32,16 +35,30 @@ struct BlockyPacket {
     /*! @brief The data inside the block */
     uint8_t *data;
 
-    /*! @brief The coefficient vector */
+    /*! @brief The coefficient vector
+
+        Not used if the packet is #seeded
+    */
     uint8_t *coeffs;
 
+    /*! @brief Whether the coefficient vector is given by #seed instead of #coeffs */
+    bool seeded;
+
+    /*! @brief The seed the coefficient vector is generated from
+
+        Only valid if the packet is #seeded
+    */
+    uint32_t seed;
+
     /*! @brief Constructor */
     BlockyPacket() :
         generation(0),
         numBlocks(0),
         blockSize(0),
         data(NULL),
-        coeffs(NULL)
+        coeffs(NULL),
+        seeded(false),
+        seed(0)
     {
 
     }
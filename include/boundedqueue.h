@@ -0,0 +1,146 @@
+/*!
+    @file
+    @brief BoundedQueue
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#ifndef _BOUNDEDQUEUE_H
+#define _BOUNDEDQUEUE_H
+
+#include <cstdlib>
+#include <condition_variable>
+#include <mutex>
+
+namespace blocky {
+
+/*! @brief Bounded Blocking Queue
+
+    A fixed-capacity FIFO between threads. Pushing waits while the queue is full and
+    popping waits while it is empty. Once closed, pushes fail and pops drain what is left.
+*/
+template <typename T> class BoundedQueue {
+
+public:
+
+    /*! @brief Constructor
+        @param[in] _capacity The maximum number of items held at once
+    */
+    explicit BoundedQueue(size_t _capacity) :
+        items(new T[_capacity]),
+        capacity(_capacity),
+        head(0),
+        count(0),
+        closed(false)
+    {
+
+    }
+
+    /*! @brief Copy constructor */
+    BoundedQueue(const BoundedQueue& other) = delete;
+
+    /*! @brief Destructor */
+    ~BoundedQueue()
+    {
+        delete [] items;
+    }
+
+    /*! @brief Assignment operator */
+    BoundedQueue& operator=(const BoundedQueue& other) = delete;
+
+    /*! @brief Adds an item, waiting for room
+        @param[in] item The item
+        @returns true on success, false if the queue has been closed
+    */
+    bool push(const T& item)
+    {
+
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || count < capacity; });
+        if (closed) {
+            return false;
+        }
+
+        items[(head + count) % capacity] = item;
+        count++;
+        notEmpty.notify_one();
+        return true;
+
+    }
+
+    /*! @brief Removes the oldest item, waiting for one
+        @param[out] item The item (will be filled in)
+        @returns true on success, false if the queue has been closed and is empty
+    */
+    bool pop(T& item)
+    {
+
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || count > 0; });
+        if (count == 0) {
+            return false;
+        }
+
+        item = items[head];
+        head = (head + 1) % capacity;
+        count--;
+        notFull.notify_one();
+        return true;
+
+    }
+
+    /*! @brief Closes the queue, waking every waiting thread */
+    void close()
+    {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+
+    }
+
+    /*! @brief Get the number of items in the queue
+        @returns The number of items
+    */
+    size_t size()
+    {
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+
+    }
+
+private:
+
+    /*! @brief The ring of items */
+    T *items;
+
+    /*! @brief The capacity */
+    size_t capacity;
+
+    /*! @brief The index of the oldest item */
+    size_t head;
+
+    /*! @brief The number of items */
+    size_t count;
+
+    /*! @brief Whether the queue has been closed */
+    bool closed;
+
+    /*! @brief Guards the ring, the count and closed */
+    std::mutex mutex;
+
+    /*! @brief Signals that an item was removed or the queue closed */
+    std::condition_variable notFull;
+
+    /*! @brief Signals that an item was added or the queue closed */
+    std::condition_variable notEmpty;
+};
+
+}
+
+#endif
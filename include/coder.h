@@ -13,6 +13,7 @@
 #include <cstdio>
 #include <cstring>
 #include "gf28.h"
+#include "prng.h"
 
 namespace blocky {
 
@@ -26,6 +27,14 @@ class Coder {
 
 public:
 
+    /*! @brief Decoding strategies */
+    enum DecodingMode {
+        ECHELON,        /*!< Keep rows in echelon form and back substitute once at full rank */
+        GAUSS_JORDAN,   /*!< Keep rows fully reduced as packets arrive, releasing blocks as soon as they are decoded */
+        DEFERRED,       /*!< Only test coefficients as packets arrive, keeping blocks as received, and apply the inverse once at full rank */
+        RECODING        /*!< Only test coefficients as packets arrive, keeping blocks as received, and never decode */
+    };
+
     /*! @brief Default constructor */
     Coder();
 
@@ -55,17 +64,71 @@ public:
     /*! @brief Creates a decoder
         @param[in] _blockSize The block size
         @param[in] _numBlocks The number of blocks
+        @param[in] _blocks The blocks to decode into
+        @warning The coder will use the blocks as is and not free them when destroyed. It is the responsibility of the caller to free the memory appropriately.
+    */
+    static Coder createDecoder(size_t _blockSize, size_t _numBlocks, uint8_t **_blocks);
+
+    /*! @brief Creates a decoder that owns its blocks
+        @param[in] _blockSize The block size
+        @param[in] _numBlocks The number of blocks
+
+        The generation is held in one allocation of records, one per row, each holding the
+        row's coefficients and then its block, both aligned to #RECORD_ALIGNMENT bytes.
+        Row operations that update both halves do so in a single pass, and the
+        elimination walks memory that prefetchers can follow. The decoded blocks are
+        read through getBlocks().
     */
     static Coder createDecoder(size_t _blockSize, size_t _numBlocks);
 
+    /*! @brief Creates a recoder
+        @param[in] _blockSize The block size
+        @param[in] _numBlocks The number of blocks
+        @returns A coder in #RECODING mode that holds its own blocks
+
+        A recoder stores innovative blocks as received, testing only their coefficients,
+        and encode() forwards fresh combinations of them. It never decodes, so relaying
+        costs one pass over the held blocks per output block and no elimination on payloads.
+    */
+    static Coder createRecoder(size_t _blockSize, size_t _numBlocks);
+
+    /*! @brief The alignment of each half of a record */
+    static const size_t RECORD_ALIGNMENT = 64;
+
     /*! @brief Stores a block
         @param[in] block The block
         @param[in] _coeffs The coefficients
-        @returns Whether the block was helpful
-        @warning The coder will take ownership of the block as is and not free it when destroyed. It is the responsibility of the caller to free memory appropriately.
+        @returns Whether the block was helpful, i.e. whether the rank increased
+
+        The block is only read if it is helpful, and is combined into one of the decoder's
+        blocks; the coder keeps no reference to it.
     */
     bool store(uint8_t *block, uint8_t *_coeffs);
 
+    /*! @brief Stores a block, taking ownership of it if it is kept as received
+        @param[in] block The block, allocated with allocateBlock()
+        @param[in] _coeffs The coefficients
+        @param[out] adopted Whether the coder took ownership of the block
+        @returns Whether the block was helpful, i.e. whether the rank increased
+
+        In #DEFERRED and #RECODING modes a helpful block is kept as is rather than copied, and is
+        freed by the coder once decoded or destroyed. Otherwise this is the same as store(), and the block stays
+        with the caller. Either way only the coefficients are read unless the block is helpful.
+    */
+    bool store(uint8_t *block, uint8_t *_coeffs, bool& adopted);
+
+    /*! @brief Stores several blocks at once
+        @param[in] _blocks The blocks
+        @param[in] _coeffs The coefficients of each block
+        @param[in] count The number of blocks
+        @returns The number of helpful blocks
+
+        Equivalent to count calls to store(), in order. The rank of the whole batch is
+        tested on the coefficients first; the payloads of the helpful blocks are then
+        combined in one pass over the generation.
+    */
+    size_t storeBatch(uint8_t **_blocks, uint8_t **_coeffs, size_t count);
+
     /*! @brief Decodes the data
         @returns Whether decoding succeeded
     */
@@ -75,9 +138,195 @@ public:
         @param[out] block The block (will be filled in)
         @param[out] _coeffs The coefficient vector (will be filled in)
         @returns Whether encoding succeeded
+
+        In systematic mode, the first numBlocks calls return the original blocks with unit
+        coefficient vectors, and coded blocks follow.
+
+        A coder that has not decoded recodes: the block is a combination of the blocks it
+        holds, computed in one pass, and the coefficient vector the same combination of theirs.
     */
     bool encode(uint8_t *block, uint8_t *_coeffs);
 
+    /*! @brief Encodes several blocks at once
+        @param[out] _blocks The blocks (will be filled in)
+        @param[out] _coeffs The coefficient vectors (will be filled in)
+        @param[in] count The number of blocks to encode
+        @returns Whether encoding succeeded
+
+        Equivalent to count calls to encode(), but the coded blocks are computed as a
+        single tiled matrix product, so the generation is streamed through cache once.
+    */
+    bool encodeBatch(uint8_t **_blocks, uint8_t **_coeffs, size_t count);
+
+    /*! @brief Encodes a block whose coefficient vector is generated from a seed
+        @param[out] block The block (will be filled in)
+        @param[out] seed The seed of the coefficient vector (will be filled in)
+        @returns Whether encoding succeeded
+
+        Only coders holding all original blocks can describe a block by a seed, and
+        systematic blocks still need their coefficient vector; encode() should be used then.
+
+        @see expandSeed
+    */
+    bool encodeSeeded(uint8_t *block, uint32_t& seed);
+
+    /*! @brief Encodes several blocks whose coefficient vectors are generated from seeds
+        @param[out] _blocks The blocks (will be filled in)
+        @param[out] _coeffs The expanded coefficient vectors (will be filled in)
+        @param[out] seeds The seeds of the coefficient vectors (will be filled in)
+        @param[in] count The number of blocks to encode
+        @param[out] unseeded The number of leading blocks that need their coefficient vector
+        @returns Whether encoding succeeded
+
+        Blocks that cannot be described by a seed (see encodeSeeded()), such as pending
+        systematic blocks, are encoded as by encodeBatch() and come first.
+
+        @see encodeBatch
+    */
+    bool encodeSeededBatch(uint8_t **_blocks, uint8_t **_coeffs, uint32_t *seeds, size_t count, size_t& unseeded);
+
+    /*! @brief Encodes a block using the caller's random number generator
+        @param[out] block The block (will be filled in)
+        @param[out] _coeffs The coefficient vector (will be filled in)
+        @param[in,out] _prng The random number generator to draw coefficients from
+        @returns Whether encoding succeeded
+
+        Reentrant: the coder is only read, so any number of threads may encode from it at
+        once, each with its own generator, as long as none stores blocks or encodes with
+        the coder's own generator meanwhile. The work is not striped across the coder's
+        thread pool. Coded blocks are always sent, never systematic ones.
+        Threads should seed their generators differently, or they will send the same blocks.
+
+        @see encode(uint8_t*, uint8_t*)
+    */
+    bool encode(uint8_t *block, uint8_t *_coeffs, PRNG& _prng) const;
+
+    /*! @brief Encodes a block whose coefficient vector is generated from a seed, using the caller's random number generator
+        @param[out] block The block (will be filled in)
+        @param[out] seed The seed of the coefficient vector (will be filled in)
+        @param[out] _coeffs The expanded coefficient vector (will be filled in)
+        @param[in,out] _prng The random number generator to draw the seed from
+        @returns Whether encoding succeeded
+
+        Reentrant in the same way as encode(uint8_t*, uint8_t*, PRNG&). Only coders holding
+        all original blocks and encoding densely can describe a block by a seed.
+    */
+    bool encodeSeeded(uint8_t *block, uint32_t& seed, uint8_t *_coeffs, PRNG& _prng) const;
+
+    /*! @brief Stores a block whose coefficient vector is given by a seed
+        @param[in] block The block
+        @param[in] seed The seed of the coefficient vector
+        @returns Whether the block was helpful, i.e. whether the rank increased
+    */
+    bool storeSeeded(uint8_t *block, uint32_t seed);
+
+    /*! @brief Stores a block whose coefficient vector is given by a seed, taking ownership of it if it is kept as received
+        @param[in] block The block, allocated with allocateBlock()
+        @param[in] seed The seed of the coefficient vector
+        @param[out] adopted Whether the coder took ownership of the block
+        @returns Whether the block was helpful, i.e. whether the rank increased
+
+        @see store(uint8_t*, uint8_t*, bool&)
+    */
+    bool storeSeeded(uint8_t *block, uint32_t seed, bool& adopted);
+
+    /*! @brief Allocates a block that a coder can take ownership of
+        @param[in] size The block size
+        @returns A block aligned to #RECORD_ALIGNMENT bytes
+    */
+    static uint8_t* allocateBlock(size_t size);
+
+    /*! @brief Frees a block allocated with allocateBlock()
+        @param[in] block The block
+    */
+    static void freeBlock(uint8_t *block);
+
+    /*! @brief Expands a seed into the coefficient vector it stands for
+        @param[in] seed The seed
+        @param[out] _coeffs The coefficient vector (will be filled in)
+    */
+    void expandSeed(uint32_t seed, uint8_t *_coeffs) const;
+
+    /*! @brief Points a coder at other storage for its blocks
+        @param[in] _blocks The blocks of data
+        @warning Only for coders created with createEncoder(), or with createDecoder() before anything is stored. As there, the blocks are used as is and not freed.
+
+        Lets the caller page a generation's data in and out, or provide a decoder's storage once its first packet arrives.
+    */
+    void setBlocks(uint8_t **_blocks);
+
+    /*! @brief Seeds the random number generator used for coefficients
+        @param[in] seed The seed
+
+        Coders are seeded randomly on creation; seeding makes encoding reproducible.
+    */
+    inline void setSeed(uint64_t seed) { prng.seed(seed); }
+
+    /*! @brief Sets whether encoding is systematic
+        @param[in] _systematic Whether to send the original blocks before coded ones
+
+        Restarts the sequence of systematic blocks. Only applies to coders holding all original
+        blocks (encoders, or decoders after decoding).
+    */
+    void setSystematic(bool _systematic);
+
+    /*! @brief Get whether encoding is systematic
+        @returns Whether encoding is systematic
+    */
+    inline bool getSystematic() { return systematic; }
+
+    /*! @brief Set the number of nonzero coefficients in each encoded block
+        @param[in] _nonzeros The number of source blocks combined, 0 for all of them
+
+        Sparse combinations are cheaper to encode and, since the decoder bounds its
+        elimination by the extent of each row, cheaper to decode. The price is a higher
+        chance of a non-innovative block; a handful of nonzeros per block keeps that low.
+        Values of 0 or at least the rank encode densely. Sparse blocks are never seeded,
+        since a seed always expands to a dense vector.
+    */
+    void setNonzeros(size_t _nonzeros);
+
+    /*! @brief Get the number of nonzero coefficients in each encoded block
+        @returns The number of source blocks combined, 0 for all of them
+    */
+    inline size_t getNonzeros() { return nonzeros; }
+
+    /*! @brief Sets the thread pool that payload work within the generation is striped across
+        @param[in] pool The pool, NULL to run on the calling thread
+
+        The coefficient work stays on the calling thread; row operations, back substitution,
+        encoding and the deferred inverse split the block size into stripes over the pool.
+
+        @see GF28::setThreadPool
+    */
+    inline void setThreadPool(ThreadPool *pool) { gf.setThreadPool(pool); }
+
+    /*! @brief Get the thread pool that payload work is striped across
+        @returns The pool, NULL if payload work runs on the calling thread
+    */
+    inline ThreadPool *getThreadPool() { return gf.getThreadPool(); }
+
+    /*! @brief Sets the decoding strategy
+        @param[in] _mode The decoding mode
+        @returns true on success, false if packets have already been stored
+    */
+    bool setDecodingMode(DecodingMode _mode);
+
+    /*! @brief Get the decoding strategy
+        @returns The decoding mode
+    */
+    inline DecodingMode getDecodingMode() { return mode; }
+
+    /*! @brief Get whether the i-th block has been decoded
+        @param[in] i The block
+        @returns Whether the i-th block holds its original data
+
+        A block is decoded once its row is a unit vector. In #GAUSS_JORDAN mode this
+        happens progressively as packets arrive; in #ECHELON mode usually only after decode(),
+        in #DEFERRED mode always only after decode(), and in #RECODING mode never.
+    */
+    bool isBlockDecoded(size_t i);
+
     /*! @brief Get the decoding status
         @returns Whether decoding has been completed
     */
@@ -86,12 +335,12 @@ public:
     /*! @brief Get the block size
         @returns The block size
     */
-    inline size_t getBlockSize() { return blockSize; }
+    inline size_t getBlockSize() const { return blockSize; }
 
     /*! @brief Get the number of blocks
         @returns The number of blocks
     */
-    inline size_t getNumBlocks() { return numBlocks; }
+    inline size_t getNumBlocks() const { return numBlocks; }
 
     /*! @brief Get the rank (number of linearly independent blocks)
         @returns The rank
@@ -135,26 +384,137 @@ private:
     */
     static void swap(Coder& first, Coder& second);
 
+    /*! @brief Allocates the records for a decoder that owns its blocks
+
+        Points the coefficient rows and blocks into the records.
+    */
+    void allocateRecords();
+
+    /*! @brief Rounds a size up to a multiple of #RECORD_ALIGNMENT
+        @param[in] size The size
+        @returns The padded size
+    */
+    static inline size_t alignRecord(size_t size) { return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1); }
+
+    /*! @brief Stores an uncoded block without elimination
+        @param[in] block The block
+        @param[in] _coeffs The coefficients
+        @param[out] pivot The row the block was stored as
+        @returns true if the block was stored, false if it needs gaussianElimination()
+
+        A unit coefficient vector for a column that has no row yet is already reduced,
+        so the block is copied straight into its slot.
+    */
+    bool storeUncoded(uint8_t *block, uint8_t *_coeffs, size_t& pivot);
+
     /*! @brief Gaussian elimination to determine whether given coefficient vector is helpful
         @param[in] _coeffs The coefficients vector
+        @param[out] pivot The pivot column of the new row, if the rank increases
         @returns Whether the coefficient vector raises the rank
 
-        Adds the given coefficient vector to the last row of the coefficient matrix, then
-        performs gaussian elimination.
+        The coefficient matrix is kept in echelon form with unit pivots, with the row
+        pivoting in column k stored as row k. The given vector is reduced against the
+        existing rows until it reaches a nonzero column that has no row yet, in
+        O(rank * numBlocks) and without allocating. In #GAUSS_JORDAN mode it is also
+        reduced against the rows after that column.
+
+        If the rank increases, the normalized vector is stored as row pivot and the
+        multipliers for rowOperations() are recorded; otherwise no change is made.
+    */
+    bool gaussianElimination(uint8_t *_coeffs, size_t& pivot);
+
+    /*! @brief Perform row operations on the received block corresponding to the operations on its coefficient vector
+        @param[in] block The received block
+        @param[in] pivot The pivot column of its row
+
+        The result is written to the block for row pivot in a single pass.
+    */
+    void rowOperations(uint8_t *block, size_t pivot);
+
+    /*! @brief Get whether encoded blocks can be described by a seed
+        @returns Whether all original blocks are present and only dense coded blocks remain to be sent
+    */
+    bool canEncodeSeeded();
+
+    /*! @brief Get whether coded blocks can be described by a seed, ignoring systematic ones
+        @returns Whether all original blocks are present and coded blocks are dense
+    */
+    inline bool canSeed() const { return decoded && (nonzeros == 0 || nonzeros >= numBlocks); }
+
+    /*! @brief Draws the coefficients for the next encoded block into drawn
+
+        Rows that are not present are always given a zero coefficient.
+    */
+    inline void drawCoefficients() { drawCoefficients(drawn, prng); }
+
+    /*! @brief Draws the coefficients for an encoded block
+        @param[out] _drawn The coefficients (will be filled in)
+        @param[in,out] _prng The random number generator to draw from
+    */
+    void drawCoefficients(uint8_t *_drawn, PRNG& _prng) const;
+
+    /*! @brief Perform the row operations for a batch of received blocks
+        @param[in] received The received blocks that raised the rank, in order
+        @param[in] pivots The pivot column of each of their rows
+        @param[in] batchMultipliers The multipliers recorded by gaussianElimination() for each block, numBlocks apiece
+        @param[in] numReceived The number of received blocks
 
-        If the rank increases, the coefficient matrix is updated; otherwise no change is made.
+        Dependencies on earlier blocks of the batch are substituted on the multipliers, so
+        each new block becomes a combination of the rows present before the batch and the
+        received blocks, and all of them are computed with a single matrix product.
     */
-    bool gaussianElimination(uint8_t *_coeffs);
+    void rowOperationsBatch(uint8_t **received, size_t *pivots, uint8_t *batchMultipliers, size_t numReceived);
+
+    /*! @brief Eliminates the given pivot column from the rows above it, in both coefficients and blocks
+        @param[in] pivot The pivot column of the newest row
 
-    /*! @brief Perform row operations on the blocks corresponding to the operations on the coefficient matrix. */
-    void rowOperations();
+        Used in #GAUSS_JORDAN mode to keep the coefficient matrix in reduced echelon form.
+    */
+    void eliminateColumn(size_t pivot);
 
     /*! @brief Perform back substitution to decode the blocks */
     void backSubstitution();
 
+    /*! @brief Decodes the received blocks by applying the inverse of their coefficients
+
+        Used in #DEFERRED mode. The received coefficient matrix is inverted by Gauss-Jordan
+        elimination on the coefficients alone, then applied to the blocks in one tiled pass.
+    */
+    void applyInverse();
+
+    /*! @brief Get the blocks as they are held
+        @returns The blocks, with adopted blocks in place of the slots they will be decoded into
+    */
+    uint8_t** heldBlocks();
+
+    /*! @brief Frees the adopted blocks */
+    void releaseOwned();
+
+    /*! @brief Get whether blocks are kept as received
+        @returns Whether the mode is #DEFERRED or #RECODING
+    */
+    inline bool keepsReceived() { return mode == DEFERRED || mode == RECODING; }
+
+    /*! @brief Get the coefficient vectors of the blocks as they are held
+        @returns The received coefficients in #DEFERRED and #RECODING modes, the reduced ones otherwise
+    */
+    inline uint8_t** getBlockCoeffs() const { return (rawCoeffs != NULL && !decoded) ? rawCoeffs : coeffs; }
+
     /*! @brief Whether the data has been decoded */
     bool decoded;
 
+    /*! @brief The decoding strategy */
+    DecodingMode mode;
+
+    /*! @brief Whether encoding is systematic */
+    bool systematic;
+
+    /*! @brief The next original block to send in systematic mode */
+    size_t systematicIndex;
+
+    /*! @brief The number of nonzero coefficients in each encoded block, 0 for all */
+    size_t nonzeros;
+
     /*! @brief The block size */
     size_t blockSize;
 
@@ -167,9 +527,39 @@ private:
     /*! @brief The coefficient matrix */
     uint8_t **coeffs;
 
+    /*! @brief The coefficients each block was received with, in #DEFERRED and #RECODING modes only */
+    uint8_t **rawCoeffs;
+
+    /*! @brief The blocks adopted in #DEFERRED and #RECODING modes, held until decoding, NULL where not adopted */
+    uint8_t **owned;
+
     /*! @brief The array of blocks */
     uint8_t **blocks;
 
+    /*! @brief Scratch row used to reduce incoming coefficient vectors */
+    uint8_t *row;
+
+    /*! @brief The multiples of each block that make up the last stored block */
+    uint8_t *multipliers;
+
+    /*! @brief Scratch array of source blocks for rowOperations() */
+    uint8_t **sources;
+
+    /*! @brief Scratch coefficient vector drawn by encode() or expanded from a seed */
+    uint8_t *drawn;
+
+    /*! @brief One past the last nonzero column of each present row */
+    size_t *rowEnds;
+
+    /*! @brief The records of a decoder that owns its blocks, NULL otherwise */
+    uint8_t *storage;
+
+    /*! @brief The size of each record */
+    size_t stride;
+
+    /*! @brief The random number generator for coefficients */
+    PRNG prng;
+
     /*! @brief The Galois Field object for finite field operations
 
         @see GF28
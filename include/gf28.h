@@ -11,9 +11,12 @@
 
 #include <cstdlib>
 #include <cstdint>
+#include <functional>
 
 namespace blocky {
 
+class ThreadPool;
+
 /*! @brief Galos Field Operations
 
     Operations are in GF(2^8) with 3 as the generator
@@ -23,7 +26,7 @@ class GF28 {
 public:
 
     /*! @brief Constructor */
-    GF28() {}
+    GF28() : pool(NULL) {}
 
     /*! @brief Destructor */
     ~GF28() {}
@@ -123,9 +126,7 @@ public:
             return;
         }
 
-        for (size_t i = 0; i < size; i++) {
-            data[i] = mul(data[i], x);
-        }
+        mulRegion(x, data, size);
     }
 
     /*! @brief Divides an array of field elements by a constant
@@ -139,9 +140,7 @@ public:
             return;
         }
 
-        for (size_t i = 0; i < size; i++) {
-            data[i] = div(data[i], x);
-        }
+        mulRegion(div(1, x), data, size);
     }
 
 
@@ -160,9 +159,7 @@ public:
             return;
         }
 
-        for (size_t i = 0; i < size; i++) {
-            data1[i] = add(data1[i], mul(data2[i], c));
-        }
+        mulAddRegion(c, data1, data2, size);
     }
 
     /*! @brief Subtracts a linear multiple of an array of field elements from another one
@@ -180,11 +177,146 @@ public:
             return;
         }
 
-        for (size_t i = 0; i < size; i++) {
-            data1[i] = sub(data1[i], mul(data2[i], c));
-        }
+        // Subtraction is addition in characteristic 2
+        mulAddRegion(c, data1, data2, size);
     }
 
+    /*! @brief Computes a linear combination of arrays of field elements
+        @param[out] data The output array (will be overwritten)
+        @param[in] c The constants of multiplication, one per source array
+        @param[in] sources The arrays to combine
+        @param[in] n The number of source arrays
+        @param[in] size The size of the arrays
+
+        Performs the operation \f$data = \sum_i c_i \cdot sources_i\f$
+
+        @see addMultiples
+    */
+    void linearCombination(uint8_t *data, const uint8_t *c, uint8_t **sources, size_t n, size_t size) const;
+
+    /*! @brief Adds a linear combination of arrays of field elements to another one
+        @param[in,out] data The base array (will be updated in place)
+        @param[in] c The constants of multiplication, one per source array
+        @param[in] sources The arrays to add multiples of
+        @param[in] n The number of source arrays
+        @param[in] size The size of the arrays
+
+        Performs the operation \f$data = data + \sum_i c_i \cdot sources_i\f$
+
+        The arrays are walked in tiles of #TILE_SIZE bytes, so each tile of data is
+        read and written once while it stays in cache, instead of once per source.
+        The output must not overlap any of the sources.
+    */
+    void addMultiples(uint8_t *data, const uint8_t *c, uint8_t **sources, size_t n, size_t size) const;
+
+    /*! @brief Computes several linear combinations of the same source arrays
+        @param[out] outputs The output arrays (will be overwritten)
+        @param[in] c The constants of multiplication, one row of n per output array
+        @param[in] m The number of output arrays
+        @param[in] sources The arrays to combine
+        @param[in] n The number of source arrays
+        @param[in] size The size of the arrays
+
+        Performs the operation \f$outputs_j = \sum_i c_{j,i} \cdot sources_i\f$ for every j
+
+        Each tile of a source is used for all outputs while it is in cache, so the
+        sources are streamed from memory once rather than once per output.
+        The outputs must not overlap any of the sources.
+    */
+    void matrixProduct(uint8_t **outputs, uint8_t **c, size_t m, uint8_t **sources, size_t n, size_t size) const;
+
+    /*! @brief Replaces arrays by linear combinations of themselves
+        @param[in,out] data The arrays (will be updated in place)
+        @param[in] c The constants of multiplication, one row of n per array
+        @param[in] n The number of arrays
+        @param[in] size The size of the arrays
+
+        Performs the operation \f$data_j = \sum_i c_{j,i} \cdot data_i\f$ for every j, at once
+
+        Works like matrixProduct(), one tile at a time, with the new tiles kept in a
+        scratch buffer of n tiles until the old ones are no longer needed.
+    */
+    void transform(uint8_t **data, uint8_t **c, size_t n, size_t size) const;
+
+    /*! @brief Computes linear combinations of arrays that may overlap the outputs
+        @param[out] outputs The output arrays (will be overwritten)
+        @param[in] c The constants of multiplication, one row of n per output array
+        @param[in] sources The arrays to combine
+        @param[in] n The number of arrays
+        @param[in] size The size of the arrays
+
+        Performs the operation \f$outputs_j = \sum_i c_{j,i} \cdot sources_i\f$ for every j, at once.
+        An output may be the same array as a source, but must not partially overlap one.
+    */
+    void transform(uint8_t **outputs, uint8_t **c, uint8_t **sources, size_t n, size_t size) const;
+
+    /*! @brief The tile size used by the multi-source operations */
+    static const size_t TILE_SIZE = 4096;
+
+    /*! @brief The amount of source data, in bytes, above which multi-source operations are striped */
+    static const size_t STRIPE_THRESHOLD = 512 * 1024;
+
+    /*! @brief Sets the thread pool that multi-source operations are striped across
+        @param[in] _pool The pool, NULL to run on the calling thread
+
+        Every output byte depends only on the source bytes at the same offset, so
+        linearCombination(), addMultiples(), matrixProduct() and transform() split their
+        arrays into stripes of whole tiles, one per thread, once they read more than
+        #STRIPE_THRESHOLD bytes. Calls made from inside the pool's own tasks are not striped.
+        The pool is not owned.
+    */
+    inline void setThreadPool(ThreadPool *_pool) { pool = _pool; }
+
+    /*! @brief Get the thread pool that multi-source operations are striped across
+        @returns The pool, NULL if they run on the calling thread
+    */
+    inline ThreadPool *getThreadPool() const { return pool; }
+
+    /*! @brief Implementations of the bulk (array) operations
+
+        The best supported implementation is selected once at startup.
+        #SCALAR is the log/antilog reference implementation.
+    */
+    enum Implementation {
+        SCALAR,         /*!< Log/antilog table lookups */
+        SSSE3,          /*!< 128 bit split nibble tables (PSHUFB) */
+        AVX2,           /*!< 256 bit split nibble tables (VPSHUFB) */
+        AVX512,         /*!< 512 bit split nibble tables (AVX-512BW VPSHUFB) */
+        GFNI_AVX2,      /*!< 256 bit GFNI multiplication (VGF2P8MULB) */
+        GFNI_AVX512,    /*!< 512 bit GFNI multiplication (VGF2P8MULB) */
+        NUM_IMPLEMENTATIONS
+    };
+
+    /*! @brief Get whether the CPU supports the given implementation
+        @param[in] impl The implementation
+        @returns Whether the implementation can be used on this CPU
+    */
+    static bool isSupported(Implementation impl);
+
+    /*! @brief Get the fastest implementation supported by the CPU
+        @returns The fastest supported implementation
+    */
+    static Implementation getBestImplementation();
+
+    /*! @brief Get the implementation currently used by the bulk operations
+        @returns The current implementation
+    */
+    static inline Implementation getImplementation() { return implementation; }
+
+    /*! @brief Selects the implementation used by the bulk operations
+        @param[in] impl The implementation
+        @returns true on success, false if the CPU does not support it
+
+        @warning Not thread safe. Intended for testing and benchmarking only.
+    */
+    static bool setImplementation(Implementation impl);
+
+    /*! @brief Get a human readable name for an implementation
+        @param[in] impl The implementation
+        @returns The name of the implementation
+    */
+    static const char *getImplementationName(Implementation impl);
+
 private:
 
     // 3 is our generator
@@ -194,6 +326,78 @@ private:
 
     /*! @brief Table of logs */
     static const uint8_t L[256]; // logs
+
+    /*! @brief Multiplies an array of field elements by a constant (reference implementation)
+        @param[in] c A field element
+        @param[in,out] data The array of field elements (will be updated in place)
+        @param[in] size The size of the array
+    */
+    static void mulRegionScalar(uint8_t c, uint8_t *data, size_t size);
+
+    /*! @brief Adds a linear multiple of an array to another one (reference implementation)
+        @param[in] c The constant of multiplication
+        @param[in,out] data1 The base array (will be updated in place)
+        @param[in] data2 The array to add multiples of
+        @param[in] size The size of the arrays
+    */
+    static void mulAddRegionScalar(uint8_t c, uint8_t *data1, const uint8_t *data2, size_t size);
+
+    /*! @brief Computes up to #PRODUCT_WIDTH linear combinations over a region of the sources
+        @param[out] outputs The output arrays (the region will be overwritten)
+        @param[in] c The constants of multiplication, one row of n per output array
+        @param[in] m The number of output arrays, at most #PRODUCT_WIDTH
+        @param[in] sources The arrays to combine
+        @param[in] n The number of source arrays
+        @param[in] offset The start of the region
+        @param[in] size The size of the region
+
+        Built on the current mulAddRegion(); the GFNI implementations instead keep the
+        outputs in registers and load each source once for all of them.
+    */
+    static void productRegionGeneric(uint8_t **outputs, uint8_t **c, size_t m, uint8_t **sources, size_t n, size_t offset, size_t size);
+
+    /*! @brief The number of outputs computed together by productRegion */
+    static const size_t PRODUCT_WIDTH = 4;
+
+    /*! @brief The implementation currently in use */
+    static Implementation implementation;
+
+    /*! @brief Multiplies an array by a constant, using the current implementation */
+    static void (*mulRegion)(uint8_t c, uint8_t *data, size_t size);
+
+    /*! @brief Adds a linear multiple of an array to another one, using the current implementation */
+    static void (*mulAddRegion)(uint8_t c, uint8_t *data1, const uint8_t *data2, size_t size);
+
+    /*! @brief Computes linear combinations over a region of several arrays, using the current implementation */
+    static void (*productRegion)(uint8_t **outputs, uint8_t **c, size_t m, uint8_t **sources, size_t n, size_t offset, size_t size);
+
+    /*! @brief Splits arrays into stripes of whole tiles and runs body on each
+        @param[in] n The number of source arrays
+        @param[in] size The size of the arrays
+        @param[in] body The work for the stripe starting at its first argument and ending before its second
+
+        Work that is not striped calls body directly, so operations without a pool never allocate.
+    */
+    template <typename F> inline void forEachStripe(size_t n, size_t size, const F& body) const
+    {
+
+        if (pool == NULL || n * size < STRIPE_THRESHOLD) {
+            body(0, size);
+            return;
+        }
+
+        stripeOnPool(size, body);
+
+    }
+
+    /*! @brief Splits arrays into stripes of whole tiles and runs body on each, across the pool
+        @param[in] size The size of the arrays
+        @param[in] body The work for the stripe starting at its first argument and ending before its second
+    */
+    void stripeOnPool(size_t size, const std::function<void(size_t, size_t)>& body) const;
+
+    /*! @brief The thread pool operations are striped across, NULL if there is none */
+    ThreadPool *pool;
 };
 
 }
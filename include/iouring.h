@@ -0,0 +1,211 @@
+/*!
+    @file
+    @brief IoUring
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#ifndef _IOURING_H
+#define _IOURING_H
+
+#include <cstdlib>
+#include <cstdint>
+
+namespace blocky {
+
+/*! @brief Asynchronous file I/O through a Linux io_uring
+
+    A minimal ring over the raw system calls, so no library is needed: reads and writes
+    are queued with a tag and run in the kernel while the caller carries on, and their
+    results are collected later with poll() or wait(). One buffer can be registered with
+    the kernel, which saves mapping its pages on every request that falls inside it.
+
+    Where io_uring is missing (other systems, kernels before 5.6 that lack plain reads
+    and writes, or blocked by a sandbox), isSupported() is false and callers keep to
+    synchronous I/O.
+
+    @warning Not thread safe; requests must be queued and collected from one thread at a time.
+*/
+class IoUring {
+
+public:
+
+    /*! @brief Default constructor, for a ring that is not available */
+    IoUring();
+
+    /*! @brief Constructor
+        @param[in] _entries The number of requests that can be in flight at once
+
+        Check getAvailable() afterwards.
+    */
+    explicit IoUring(unsigned _entries);
+
+    /*! @brief Copy constructor */
+    IoUring(const IoUring& other) = delete;
+
+    /*! @brief Move constructor */
+    IoUring(IoUring&& other);
+
+    /*! @brief Destructor
+
+        Waits for requests still in flight, since the kernel may be using their buffers.
+    */
+    ~IoUring();
+
+    /*! @brief Assignment operator */
+    IoUring& operator=(IoUring& other);
+
+    /*! @brief Move operator */
+    IoUring& operator=(IoUring&& other);
+
+    /*! @brief Get whether io_uring can be used on this system
+        @returns Whether a ring can be set up and the kernel can read and write through it
+    */
+    static bool isSupported();
+
+    /*! @brief Get whether the ring was set up
+        @returns Whether requests can be queued
+    */
+    inline bool getAvailable() { return ringFd >= 0; }
+
+    /*! @brief Get the number of requests that can be in flight at once
+        @returns The number of entries
+    */
+    inline size_t getEntries() { return entries; }
+
+    /*! @brief Get the number of requests in flight
+        @returns The number of requests queued and not collected yet
+    */
+    inline size_t getPending() { return pending; }
+
+    /*! @brief Get the number of requests the kernel has not completed yet
+        @returns The number of requests in flight less those completed and not collected
+    */
+    size_t getRunning();
+
+    /*! @brief Registers a buffer that later requests may fall inside
+        @param[in] data The buffer
+        @param[in] length The length of the buffer
+        @returns true on success, false if the kernel refused (for example over the locked memory limit)
+    */
+    bool registerBuffer(uint8_t *data, size_t length);
+
+    /*! @brief Queues a read
+        @param[in] fd The file descriptor
+        @param[out] data The destination (filled in once the read completes)
+        @param[in] length The number of bytes to read
+        @param[in] offset The offset in the file
+        @param[in] tag The tag the completion carries
+        @returns true on success, false if the ring is full or not available
+    */
+    bool submitRead(int fd, uint8_t *data, size_t length, size_t offset, uint64_t tag);
+
+    /*! @brief Queues a write
+        @param[in] fd The file descriptor
+        @param[in] data The source, which must stay in place until the write completes
+        @param[in] length The number of bytes to write
+        @param[in] offset The offset in the file
+        @param[in] tag The tag the completion carries
+        @returns true on success, false if the ring is full or not available
+    */
+    bool submitWrite(int fd, const uint8_t *data, size_t length, size_t offset, uint64_t tag);
+
+    /*! @brief Collects a completed request, if there is one
+        @param[out] tag The tag of the request
+        @param[out] result The number of bytes transferred, or a negated errno
+        @returns true if a request was collected
+    */
+    bool poll(uint64_t& tag, int& result);
+
+    /*! @brief Waits for a request to complete and collects it
+        @param[out] tag The tag of the request
+        @param[out] result The number of bytes transferred, or a negated errno
+        @returns true if a request was collected, false if none is in flight
+
+        Only returns false once nothing is in flight, so buffers are safe to free afterwards.
+    */
+    bool wait(uint64_t& tag, int& result);
+
+private:
+
+    /*! @brief Swaps two IoUring objects
+        @param[in,out] first The first IoUring
+        @param[in,out] second The second IoUring
+    */
+    void swap(IoUring& first, IoUring& second);
+
+    /*! @brief Queues a request
+        @param[in] opcode The operation
+        @param[in] fd The file descriptor
+        @param[in] data The buffer
+        @param[in] length The number of bytes
+        @param[in] offset The offset in the file
+        @param[in] tag The tag the completion carries
+        @returns true on success, false if the ring is full or not available
+    */
+    bool submit(uint8_t opcode, int fd, const uint8_t *data, size_t length, size_t offset, uint64_t tag);
+
+    /*! @brief Sets up a ring and asks the kernel which operations it supports
+        @returns Whether plain reads and writes are supported
+    */
+    static bool probe();
+
+    /*! @brief Unmaps the rings and closes the ring file descriptor */
+    void release();
+
+    /*! @brief The ring file descriptor, -1 if not available */
+    int ringFd;
+
+    /*! @brief The number of submission entries */
+    unsigned entries;
+
+    /*! @brief The number of requests in flight */
+    size_t pending;
+
+    /*! @brief The mapped submission ring */
+    void *sqRing;
+
+    /*! @brief The size of the submission ring mapping */
+    size_t sqRingSize;
+
+    /*! @brief The mapped completion ring, the same as sqRing if the kernel maps them together */
+    void *cqRing;
+
+    /*! @brief The size of the completion ring mapping */
+    size_t cqRingSize;
+
+    /*! @brief The mapped submission entries */
+    void *sqes;
+
+    /*! @brief The submission ring tail, advanced by us */
+    unsigned *sqTail;
+
+    /*! @brief The submission ring mask */
+    unsigned sqMask;
+
+    /*! @brief The submission ring's array of entry indices */
+    unsigned *sqArray;
+
+    /*! @brief The completion ring head, advanced by us */
+    unsigned *cqHead;
+
+    /*! @brief The completion ring tail, advanced by the kernel */
+    unsigned *cqTail;
+
+    /*! @brief The completion ring mask */
+    unsigned cqMask;
+
+    /*! @brief The completion entries */
+    void *cqes;
+
+    /*! @brief The registered buffer, NULL if none */
+    uint8_t *fixedBuffer;
+
+    /*! @brief The length of the registered buffer */
+    size_t fixedLength;
+};
+
+}
+
+#endif
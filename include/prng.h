@@ -0,0 +1,124 @@
+/*!
+    @file
+    @brief Pseudo Random Number Generator
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#ifndef _PRNG_H
+#define _PRNG_H
+
+#include <cstdlib>
+#include <cstdint>
+
+namespace blocky {
+
+/*! @brief Pseudo Random Number Generator
+
+    xoshiro128** seeded through splitmix64. Small, fast and reproducible for a given seed,
+    which lets a coefficient vector be sent as its seed.
+
+    @warning Not cryptographically secure
+*/
+class PRNG {
+
+public:
+
+    /*! @brief Constructor
+        @param[in] _seed The seed
+    */
+    explicit PRNG(uint64_t _seed = 0)
+    {
+        seed(_seed);
+    }
+
+    /*! @brief Destructor */
+    ~PRNG() {}
+
+    /*! @brief Reseeds the generator
+        @param[in] _seed The seed
+    */
+    inline void seed(uint64_t _seed)
+    {
+
+        for (size_t i = 0; i < 4; i += 2) {
+            uint64_t z = splitmix64(_seed);
+            state[i] = (uint32_t) z;
+            state[i+1] = (uint32_t) (z >> 32);
+        }
+
+    }
+
+    /*! @brief Generates the next random number
+        @returns A uniformly distributed 32 bit number
+    */
+    inline uint32_t next()
+    {
+
+        uint32_t result = rotl(state[1] * 5, 7) * 9;
+        uint32_t t = state[1] << 9;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 11);
+
+        return result;
+
+    }
+
+    /*! @brief Fills an array with uniformly distributed nonzero bytes
+        @param[out] data The array (will be filled in)
+        @param[in] size The size of the array
+    */
+    inline void nonzeroBytes(uint8_t *data, size_t size)
+    {
+
+        size_t i = 0;
+        while (i < size) {
+            uint32_t r = next();
+            for (size_t j = 0; j < 4 && i < size; j++, r >>= 8) {
+                if ((r & 0xff) != 0) {
+                    data[i++] = (uint8_t) r;
+                }
+            }
+        }
+
+    }
+
+private:
+
+    /*! @brief Rotates left
+        @param[in] x The value
+        @param[in] k The number of bits
+        @returns x rotated left by k bits
+    */
+    static inline uint32_t rotl(uint32_t x, int k)
+    {
+        return (x << k) | (x >> (32 - k));
+    }
+
+    /*! @brief Advances a splitmix64 state
+        @param[in,out] x The state
+        @returns The next output
+    */
+    static inline uint64_t splitmix64(uint64_t& x)
+    {
+
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+
+    }
+
+    /*! @brief The generator state */
+    uint32_t state[4];
+};
+
+}
+
+#endif
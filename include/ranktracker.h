@@ -0,0 +1,129 @@
+/*!
+    @file
+    @brief RankTracker
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#ifndef _RANKTRACKER_H
+#define _RANKTRACKER_H
+
+#include <cstdlib>
+#include <cstring>
+#include "gf28.h"
+#include "prng.h"
+
+namespace blocky {
+
+/*! @brief Tracks the rank of a generation from coefficient vectors alone
+
+    Runs the same elimination as Coder on the coefficients, without any blocks, so it
+    answers whether a packet would be innovative for whoever it mirrors. A tracker takes
+    numBlocks * (numBlocks + 1) bytes, which keeps one per peer and generation cheap.
+
+    @see Coder
+*/
+class RankTracker {
+
+public:
+
+    /*! @brief Default constructor */
+    RankTracker();
+
+    /*! @brief Constructor
+        @param[in] _numBlocks The number of blocks in the generation
+    */
+    explicit RankTracker(size_t _numBlocks);
+
+    /*! @brief Copy constructor */
+    RankTracker(const RankTracker& other);
+
+    /*! @brief Move constructor */
+    RankTracker(RankTracker&& other);
+
+    /*! @brief Destructor */
+    ~RankTracker();
+
+    /*! @brief Assignment operator */
+    RankTracker& operator=(RankTracker& other);
+
+    /*! @brief Move operator */
+    RankTracker& operator=(RankTracker&& other);
+
+    /*! @brief Tests a coefficient vector without storing it
+        @param[in] coeffs The coefficients
+        @returns Whether the vector would raise the rank
+    */
+    bool isInnovative(const uint8_t *coeffs);
+
+    /*! @brief Stores a coefficient vector
+        @param[in] coeffs The coefficients
+        @returns Whether the vector raised the rank
+    */
+    bool store(const uint8_t *coeffs);
+
+    /*! @brief Stores a coefficient vector given by its seed
+        @param[in] seed The seed, expanded as by Coder::expandSeed
+        @returns Whether the vector raised the rank
+    */
+    bool storeSeeded(uint32_t seed);
+
+    /*! @brief Forgets all stored vectors */
+    void reset();
+
+    /*! @brief Get the number of blocks
+        @returns The number of blocks
+    */
+    inline size_t getNumBlocks() { return numBlocks; }
+
+    /*! @brief Get the rank
+        @returns The rank
+    */
+    inline size_t getRank() { return rank; }
+
+    /*! @brief Get whether the rank is full
+        @returns Whether no vector can be innovative any more
+    */
+    inline bool isFull() { return rank == numBlocks; }
+
+private:
+
+    /*! @brief Swaps two RankTracker objects
+        @param[in,out] first The first RankTracker
+        @param[in,out] second The second RankTracker
+    */
+    void swap(RankTracker& first, RankTracker& second);
+
+    /*! @brief Reduces the scratch row against the stored rows
+        @returns The column the reduced row pivots in, numBlocks if it is not innovative
+
+        As in Coder, row k pivots in column k with a unit pivot, so reduction stops at
+        the first nonzero column that has no row yet.
+    */
+    size_t reduceRow();
+
+    /*! @brief Stores the scratch row if it raises the rank
+        @returns Whether the rank increased
+    */
+    bool storeRow();
+
+    /*! @brief The number of blocks */
+    size_t numBlocks;
+
+    /*! @brief The rank */
+    size_t rank;
+
+    /*! @brief The rows, numBlocks apiece, followed by the scratch row */
+    uint8_t *matrix;
+
+    /*! @brief The scratch row */
+    uint8_t *row;
+
+    /*! @brief The Galois field */
+    GF28 gf;
+};
+
+}
+
+#endif
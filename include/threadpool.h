@@ -0,0 +1,160 @@
+/*!
+    @file
+    @brief ThreadPool
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <cstdlib>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace blocky {
+
+/*! @brief Work-stealing Thread Pool
+
+    Runs the iterations of a loop across a fixed set of threads. Each thread starts on
+    its own contiguous share of the iterations and, once that runs out, steals from the
+    others. Iterations are claimed with an atomic increment, so no lock is taken while
+    the loop runs.
+
+    The calling thread takes part in every loop, so a pool of n threads starts n - 1
+    workers. Loops started from inside an iteration run serially on the calling thread.
+*/
+class ThreadPool {
+
+public:
+
+    /*! @brief Constructor, sized to the number of hardware threads */
+    ThreadPool();
+
+    /*! @brief Constructor
+        @param[in] _numThreads The number of threads to run loops on, including the caller
+    */
+    explicit ThreadPool(size_t _numThreads);
+
+    /*! @brief Copy constructor */
+    ThreadPool(const ThreadPool& other) = delete;
+
+    /*! @brief Destructor, stops and joins the workers */
+    ~ThreadPool();
+
+    /*! @brief Assignment operator */
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    /*! @brief Runs body(i) for every i in [0, count) and waits for all of them
+        @param[in] count The number of iterations
+        @param[in] body The loop body
+
+        Iterations must be independent of each other. If any of them throws, the remaining
+        ones still run and the first exception is rethrown here.
+    */
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    /*! @brief Get the number of threads loops run on
+        @returns The number of threads, including the caller
+    */
+    inline size_t getNumThreads() { return workers.size() + 1; }
+
+    /*! @brief Get a pool shared by the whole process, sized to the machine
+        @returns The shared pool
+    */
+    static ThreadPool& getDefault();
+
+private:
+
+    /*! @brief A share of the iterations of a loop */
+    struct Range {
+
+        /*! @brief The next iteration to claim */
+        std::atomic<size_t> next;
+
+        /*! @brief One past the last iteration */
+        size_t end;
+    };
+
+    /*! @brief A running loop */
+    struct Job {
+
+        /*! @brief Constructor
+            @param[in] _body The loop body
+            @param[in] count The number of iterations
+            @param[in] _numRanges The number of shares to split them into
+        */
+        Job(const std::function<void(size_t)>& _body, size_t count, size_t _numRanges);
+
+        /*! @brief Destructor */
+        ~Job();
+
+        /*! @brief The loop body */
+        const std::function<void(size_t)>& body;
+
+        /*! @brief The shares, one per thread */
+        Range *ranges;
+
+        /*! @brief The number of shares */
+        size_t numRanges;
+
+        /*! @brief The number of workers still inside the loop, guarded by the pool's mutex */
+        size_t active;
+
+        /*! @brief The first exception thrown by an iteration */
+        std::exception_ptr error;
+
+        /*! @brief Guards error */
+        std::mutex errorMutex;
+    };
+
+    /*! @brief Starts the workers
+        @param[in] _numThreads The number of threads, including the caller
+    */
+    void start(size_t _numThreads);
+
+    /*! @brief The loop each worker runs
+        @param[in] index The index of the worker's share in every job
+    */
+    void work(size_t index);
+
+    /*! @brief Runs iterations of a job until none are left to claim
+        @param[in,out] job The job
+        @param[in] index The share to start with
+    */
+    static void run(Job& job, size_t index);
+
+    /*! @brief The workers */
+    std::vector<std::thread> workers;
+
+    /*! @brief Guards current, serial and stopping */
+    std::mutex mutex;
+
+    /*! @brief Serializes loops started from different threads */
+    std::mutex submitMutex;
+
+    /*! @brief Wakes the workers for a new job or to stop */
+    std::condition_variable wake;
+
+    /*! @brief Signals that the last worker has left a job */
+    std::condition_variable done;
+
+    /*! @brief The running job, NULL if there is none */
+    Job *current;
+
+    /*! @brief Counts jobs, so a worker joins each one once */
+    size_t serial;
+
+    /*! @brief Whether the workers should exit */
+    bool stopping;
+};
+
+}
+
+#endif
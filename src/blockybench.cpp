@@ -13,6 +13,9 @@
 #include "blockycodermemory.h"
 #include "blockycoderfile.h"
 #include "blockycodermmap.h"
+#include "blockycoderstream.h"
+#include "ranktracker.h"
+#include "threadpool.h"
 
 #include <vector>
 #include <algorithm>
@@ -21,6 +24,7 @@
 #include <iostream>
 #include <fstream>
 #include <sys/time.h>
+#include <thread>
 
 using namespace std;
 using namespace blocky;
@@ -41,7 +45,7 @@ size_t timeDelta(struct timeval& start, struct timeval& end)
 
 }
 
-template <typename B> void benchCoder(const char *name, size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numIterations) 
+template <typename B> void benchCoder(const char *name, size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numIterations, Coder::DecodingMode mode) 
 {
 
     uint8_t *data = new uint8_t[dataLength];
@@ -67,6 +71,7 @@ template <typename B> void benchCoder(const char *name, size_t blockSize, size_t
     size_t minEncodePerPacket, minEncodePerGeneration, minDecodePerPacket, minDecodePerGeneration, minDecodePerFile, minFlush, minTime;
     size_t maxEncodePerPacket, maxEncodePerGeneration, maxDecodePerPacket, maxDecodePerGeneration, maxDecodePerFile, maxFlush, maxTime;
     size_t counter, numGenerations;
+    size_t packetsReceived = 0, blocksReceived = 0;
 
     for (size_t k = 0; k < numIterations; k++) {
 
@@ -76,6 +81,7 @@ template <typename B> void benchCoder(const char *name, size_t blockSize, size_t
 
         B encoder = Utils::createBlockyEncoder<B>(blockSize, blocksPerGeneration, dataLength, "test.enc", data);
         B decoder = Utils::createBlockyDecoder<B>(blockSize, blocksPerGeneration, dataLength, "test.dec", data);
+        decoder.setDecodingMode(mode);
 
         numGenerations = encoder.getNumGenerations();
         for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
@@ -119,13 +125,24 @@ template <typename B> void benchCoder(const char *name, size_t blockSize, size_t
         decodeTimePerFile.push_back(0);
         for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
 
-            for (size_t j = 0; j < (encoder.getNumBlocksInGeneration(i)+1); j++) {
+            // Feed packets until the generation is decodable, encoding more if the spare one was not enough
+            for (size_t j = 0; !decoder.canDecodeGeneration(i); j++) {
+
+                BlockyPacket packet;
+                if (j < (encoder.getNumBlocksInGeneration(i)+1)) {
+                    packet = packets[counter + j];
+                } else if (encoder.encode(packet, i)) {
+                    buffers.push_back(packet.data);
+                    buffers.push_back(packet.coeffs);
+                } else {
+                    goto err;
+                }
 
                 if (gettimeofday(&start2, NULL)) {
                     goto err;
                 }
 
-                if (!decoder.store(packets[counter++])) {
+                if (!decoder.store(packet)) {
                     // Ignore, this can happen
                 }
 
@@ -134,9 +151,13 @@ template <typename B> void benchCoder(const char *name, size_t blockSize, size_t
                 }
 
                 decodeTimePerPacket.push_back(timeDelta(start2, end2));
+                packetsReceived++;
 
             }
 
+            counter += encoder.getNumBlocksInGeneration(i)+1;
+            blocksReceived += encoder.getNumBlocksInGeneration(i);
+
             if (!decoder.canDecodeGeneration(i)) {
                 goto err;
             }
@@ -203,7 +224,7 @@ template <typename B> void benchCoder(const char *name, size_t blockSize, size_t
     maxFlush = *max_element(timePerFlush.begin(), timePerFlush.end());
     maxTime = *max_element(totalTime.begin(), totalTime.end()); 
 
-    printf("%s(%lu, %lu, %lu) - %lu G: TT %lu (%lu -> %lu), EP %lu (%lu -> %lu), EG %lu (%lu -> %lu), DP %lu (%lu -> %lu), DG %lu (%lu -> %lu), DF %lu (%lu -> %lu), FL %lu (%lu -> %lu)\n", name, blockSize, blocksPerGeneration, dataLength, numGenerations, averageTime, minTime, maxTime, averageEncodePerPacket, minEncodePerPacket, maxEncodePerPacket, averageEncodePerGeneration, minEncodePerGeneration, maxEncodePerGeneration, averageDecodePerPacket, minDecodePerPacket, maxDecodePerPacket, averageDecodePerGeneration, minDecodePerGeneration, maxDecodePerGeneration, averageDecodePerFile, minDecodePerFile, maxDecodePerFile, averageFlush, minFlush, maxFlush);
+    printf("%s(%lu, %lu, %lu) - %lu G: TT %lu (%lu -> %lu), EP %lu (%lu -> %lu), EG %lu (%lu -> %lu), DP %lu (%lu -> %lu), DG %lu (%lu -> %lu), DF %lu (%lu -> %lu), FL %lu (%lu -> %lu), OH %.4f\n", name, blockSize, blocksPerGeneration, dataLength, numGenerations, averageTime, minTime, maxTime, averageEncodePerPacket, minEncodePerPacket, maxEncodePerPacket, averageEncodePerGeneration, minEncodePerGeneration, maxEncodePerGeneration, averageDecodePerPacket, minDecodePerPacket, maxDecodePerPacket, averageDecodePerGeneration, minDecodePerGeneration, maxDecodePerGeneration, averageDecodePerFile, minDecodePerFile, maxDecodePerFile, averageFlush, minFlush, maxFlush, (double) packetsReceived / blocksReceived);
 
 err:
     freeBuffers(buffers);
@@ -212,6 +233,241 @@ err:
     remove("test.dec");
 }
 
+void benchGF28(size_t blockSize, size_t numIterations)
+{
+
+    GF28 gf;
+    uint8_t *data1 = new uint8_t[blockSize];
+    uint8_t *data2 = new uint8_t[blockSize];
+    for (size_t i = 0; i < blockSize; i++) {
+        data1[i] = rand() % 256;
+        data2[i] = rand() % 256;
+    }
+
+    GF28::Implementation best = GF28::getImplementation();
+    for (int i = 0; i < GF28::NUM_IMPLEMENTATIONS; i++) {
+
+        GF28::Implementation impl = (GF28::Implementation) i;
+        if (!GF28::setImplementation(impl)) {
+            continue;
+        }
+
+        struct timeval start, end;
+        if (gettimeofday(&start, NULL)) {
+            break;
+        }
+
+        for (size_t k = 0; k < numIterations; k++) {
+            gf.addMultiple((k % 255) + 1, data1, data2, blockSize);
+        }
+
+        if (gettimeofday(&end, NULL)) {
+            break;
+        }
+
+        size_t elapsed = max(timeDelta(start, end), (size_t) 1);
+        printf("GF28::addMultiple(%s, %lu) - %lu MB/s%s\n", GF28::getImplementationName(impl), blockSize, (blockSize * numIterations) / elapsed, (impl == best) ? " (selected)" : "");
+    }
+
+    GF28::setImplementation(best);
+    delete [] data1;
+    delete [] data2;
+}
+
+void benchTransfer(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, double lossRate, bool systematic, bool seeded, size_t nonzeros, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    struct timeval start, end;
+    size_t encodeTime = 0, decodeTime = 0, packetsSent = 0, blocksSent = 0, headerBytes = 0;
+
+    for (size_t k = 0; k < numIterations; k++) {
+
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setSystematic(systematic);
+        encoder.setSeeded(seeded);
+        encoder.setNonzeros(nonzeros);
+
+        BlockyPacket packet;
+        for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+
+            while (!decoder.canDecodeGeneration(i)) {
+
+                gettimeofday(&start, NULL);
+                encoder.encode(packet, i);
+                gettimeofday(&end, NULL);
+                encodeTime += timeDelta(start, end);
+                packetsSent++;
+                headerBytes += packet.seeded ? sizeof(packet.seed) : packet.numBlocks;
+
+                // Simulate packet loss
+                if (((double) rand() / RAND_MAX) < lossRate) {
+                    continue;
+                }
+
+                gettimeofday(&start, NULL);
+                decoder.store(packet);
+                gettimeofday(&end, NULL);
+                decodeTime += timeDelta(start, end);
+            }
+
+            gettimeofday(&start, NULL);
+            decoder.decodeGeneration(i);
+            gettimeofday(&end, NULL);
+            decodeTime += timeDelta(start, end);
+        }
+
+        blocksSent += encoder.getNumBlocks();
+        delete [] packet.data;
+        delete [] packet.coeffs;
+    }
+
+    size_t bytes = dataLength * numIterations;
+    double averageHeader = (double) headerBytes / packetsSent;
+    printf("BlockyCoderMemory%s%s(%lu, %lu, %lu) - loss %.2f, D %lu: ET %lu, DT %lu, ER %lu MB/s, DR %lu MB/s, OH %.4f, HB %.1f (%.2f%%)\n", systematic ? "Systematic" : "", seeded ? "Seeded" : "", blockSize, blocksPerGeneration, dataLength, lossRate, nonzeros ? nonzeros : blocksPerGeneration, encodeTime / numIterations, decodeTime / numIterations, bytes / max(encodeTime, (size_t) 1), bytes / max(decodeTime, (size_t) 1), (double) packetsSent / blocksSent, averageHeader, 100.0 * averageHeader / (averageHeader + blockSize));
+
+    delete [] data;
+}
+
+void benchEncodeBatch(size_t blockSize, size_t blocksPerGeneration, size_t count, size_t numIterations)
+{
+
+    size_t dataLength = blockSize * blocksPerGeneration;
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+    BlockyPacket *packets = new BlockyPacket[count];
+    struct timeval start, end;
+
+    gettimeofday(&start, NULL);
+    for (size_t k = 0; k < numIterations; k++) {
+        if (count == 1) {
+            encoder.encode(packets[0], 0);
+        } else {
+            encoder.encodeBatch(0, count, packets);
+        }
+    }
+    gettimeofday(&end, NULL);
+    size_t elapsed = max(timeDelta(start, end), (size_t) 1);
+
+    printf("BlockyCoderMemory::encode%s(%lu, %lu, %lu) - %lu MB/s\n", (count == 1) ? "" : "Batch", blockSize, blocksPerGeneration, count, (blockSize * count * numIterations) / elapsed);
+
+    for (size_t j = 0; j < count; j++) {
+        delete [] packets[j].data;
+        delete [] packets[j].coeffs;
+    }
+    delete [] packets;
+    delete [] data;
+}
+
+void benchStoreBatch(size_t blockSize, size_t blocksPerGeneration, size_t count, size_t numIterations)
+{
+
+    size_t dataLength = blockSize * blocksPerGeneration;
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    // Enough coded packets to decode the generation, with a few to spare
+    size_t numPackets = blocksPerGeneration + 8;
+    BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+    BlockyPacket *packets = new BlockyPacket[numPackets];
+    encoder.encodeBatch(0, numPackets, packets);
+
+    struct timeval start, end;
+    size_t elapsed = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        gettimeofday(&start, NULL);
+        for (size_t j = 0; j < numPackets && !decoder.canDecodeGeneration(0); j += count) {
+            if (count == 1) {
+                decoder.store(packets[j]);
+            } else {
+                decoder.storeBatch(&packets[j], min(count, numPackets - j));
+            }
+        }
+        decoder.decodeGeneration(0);
+        gettimeofday(&end, NULL);
+        elapsed += timeDelta(start, end);
+    }
+
+    printf("BlockyCoderMemory::store%s(%lu, %lu, %lu) - %lu MB/s\n", (count == 1) ? "" : "Batch", blockSize, blocksPerGeneration, count, (dataLength * numIterations) / max(elapsed, (size_t) 1));
+
+    for (size_t j = 0; j < numPackets; j++) {
+        delete [] packets[j].data;
+        delete [] packets[j].coeffs;
+    }
+    delete [] packets;
+    delete [] data;
+}
+
+void benchCoderLayout(size_t blockSize, size_t numBlocks, Coder::DecodingMode mode, bool augmented, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[blockSize * numBlocks];
+    uint8_t *output = new uint8_t[blockSize * numBlocks];
+    uint8_t **blocks = new uint8_t*[numBlocks];
+    uint8_t **outputBlocks = new uint8_t*[numBlocks];
+    for (size_t i = 0; i < blockSize * numBlocks; i++) {
+        data[i] = rand() % 256;
+    }
+    for (size_t i = 0; i < numBlocks; i++) {
+        blocks[i] = &data[i * blockSize];
+        outputBlocks[i] = &output[i * blockSize];
+    }
+
+    // Pre-encode enough packets, so only decoding is timed
+    size_t numPackets = numBlocks + 8;
+    uint8_t **packets = new uint8_t*[numPackets];
+    uint8_t **coeffs = new uint8_t*[numPackets];
+    for (size_t j = 0; j < numPackets; j++) {
+        packets[j] = new uint8_t[blockSize];
+        coeffs[j] = new uint8_t[numBlocks];
+    }
+    Coder encoder = Coder::createEncoder(blockSize, numBlocks, blocks);
+    encoder.encodeBatch(packets, coeffs, numPackets);
+
+    struct timeval start, end;
+    size_t elapsed = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        Coder decoder = augmented ? Coder::createDecoder(blockSize, numBlocks) : Coder::createDecoder(blockSize, numBlocks, outputBlocks);
+        decoder.setDecodingMode(mode);
+
+        gettimeofday(&start, NULL);
+        for (size_t j = 0; j < numPackets && !decoder.canDecode(); j++) {
+            decoder.store(packets[j], coeffs[j]);
+        }
+        decoder.decode();
+        gettimeofday(&end, NULL);
+        elapsed += timeDelta(start, end);
+    }
+
+    const char *modeNames[] = {"Echelon", "GaussJordan", "Deferred"};
+    printf("Coder%s%s(%lu, %lu) - %lu MB/s\n", modeNames[mode], augmented ? "Augmented" : "", blockSize, numBlocks, (blockSize * numBlocks * numIterations) / max(elapsed, (size_t) 1));
+
+    for (size_t j = 0; j < numPackets; j++) {
+        delete [] packets[j];
+        delete [] coeffs[j];
+    }
+    delete [] packets;
+    delete [] coeffs;
+    delete [] blocks;
+    delete [] outputBlocks;
+    delete [] output;
+    delete [] data;
+}
+
 struct MultiTestCase {
     size_t blockSize;
     size_t blocksPerGeneration;
@@ -219,11 +475,544 @@ struct MultiTestCase {
     size_t numIterations;
 };
 
-template <typename B> void benchCoderMulti(vector<MultiTestCase> cases, const char *name)
+void benchRelay(size_t blockSize, size_t numBlocks, bool recode, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[blockSize * numBlocks];
+    uint8_t **blocks = new uint8_t*[numBlocks];
+    for (size_t i = 0; i < blockSize * numBlocks; i++) {
+        data[i] = rand() % 256;
+    }
+    for (size_t i = 0; i < numBlocks; i++) {
+        blocks[i] = &data[i * blockSize];
+    }
+
+    size_t numPackets = numBlocks + 8;
+    uint8_t **packets = new uint8_t*[numPackets];
+    uint8_t **coeffs = new uint8_t*[numPackets];
+    for (size_t j = 0; j < numPackets; j++) {
+        packets[j] = new uint8_t[blockSize];
+        coeffs[j] = new uint8_t[numBlocks];
+    }
+    Coder encoder = Coder::createEncoder(blockSize, numBlocks, blocks);
+    encoder.encodeBatch(packets, coeffs, numPackets);
+
+    uint8_t *forwarded = new uint8_t[blockSize];
+    uint8_t *forwardedCoeffs = new uint8_t[numBlocks];
+
+    // One hop: take in a generation and forward as many packets as were received
+    struct timeval start, end;
+    size_t elapsed = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        Coder relay = recode ? Coder::createRecoder(blockSize, numBlocks) : Coder::createDecoder(blockSize, numBlocks);
+
+        gettimeofday(&start, NULL);
+        for (size_t j = 0; j < numPackets && !relay.canDecode(); j++) {
+            relay.store(packets[j], coeffs[j]);
+        }
+        relay.decode();
+        for (size_t j = 0; j < numBlocks; j++) {
+            relay.encode(forwarded, forwardedCoeffs);
+        }
+        gettimeofday(&end, NULL);
+        elapsed += timeDelta(start, end);
+    }
+
+    printf("Relay%s(%lu, %lu) - %lu MB/s\n", recode ? "Recode" : "Decode", blockSize, numBlocks, (blockSize * numBlocks * numIterations) / max(elapsed, (size_t) 1));
+
+    for (size_t j = 0; j < numPackets; j++) {
+        delete [] packets[j];
+        delete [] coeffs[j];
+    }
+    delete [] packets;
+    delete [] coeffs;
+    delete [] forwarded;
+    delete [] forwardedCoeffs;
+    delete [] blocks;
+    delete [] data;
+}
+
+void benchRankTracker(size_t numBlocks, size_t numIterations)
+{
+
+    // Full rank plus a few non-innovative vectors per generation
+    size_t numVectors = numBlocks + 8;
+    uint8_t *vectors = new uint8_t[numVectors * numBlocks];
+    for (size_t i = 0; i < numVectors * numBlocks; i++) {
+        vectors[i] = rand() % 256;
+    }
+
+    struct timeval start, end;
+    size_t stored = 0;
+    gettimeofday(&start, NULL);
+    RankTracker tracker(numBlocks);
+    for (size_t k = 0; k < numIterations; k++) {
+        tracker.reset();
+        for (size_t j = 0; j < numVectors; j++) {
+            stored += tracker.store(&vectors[j * numBlocks]);
+        }
+    }
+    gettimeofday(&end, NULL);
+
+    printf("RankTracker(%lu) - %lu vectors/ms, %lu innovative\n", numBlocks, (numVectors * numIterations * 1000) / max(timeDelta(start, end), (size_t) 1), stored);
+
+    delete [] vectors;
+}
+
+void benchParallel(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numThreads, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    ThreadPool pool(numThreads);
+    struct timeval start, end;
+    size_t encodeTime = 0, decodeTime = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setThreadPool(&pool);
+        decoder.setThreadPool(&pool);
+
+        size_t count = blocksPerGeneration + 2;
+        vector<BlockyPacket> packets(count * encoder.getNumGenerations());
+
+        gettimeofday(&start, NULL);
+        encoder.encodeGenerations(count, packets.data());
+        gettimeofday(&end, NULL);
+        encodeTime += timeDelta(start, end);
+
+        // Only the decoding step runs on the pool; storing is per packet
+        for (size_t j = 0; j < packets.size(); j++) {
+            decoder.store(packets[j]);
+            delete [] packets[j].data;
+            delete [] packets[j].coeffs;
+        }
+
+        gettimeofday(&start, NULL);
+        decoder.decode();
+        gettimeofday(&end, NULL);
+        decodeTime += timeDelta(start, end);
+    }
+
+    printf("Parallel(%lu, %lu, %lu, %lu threads) - Encode: %lu MB/s, Decode: %lu MB/s\n", blockSize, blocksPerGeneration, dataLength, numThreads,
+           (dataLength * numIterations) / max(encodeTime, (size_t) 1), (dataLength * numIterations) / max(decodeTime, (size_t) 1));
+
+    delete [] data;
+}
+
+void benchConcurrentEncode(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numThreads, size_t packetsPerThread, bool shared)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+
+    // Shared, the encoder also has per-generation locks and a thread pool, as when it receives too
+    ThreadPool pool(numThreads);
+    if (shared) {
+        encoder.setConcurrentStore();
+        encoder.setThreadPool(&pool);
+    }
+
+    // Each sender has its own generator and packet, and walks the generations from its own start
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    vector<thread> threads;
+    for (size_t t = 0; t < numThreads; t++) {
+        threads.push_back(thread([&encoder, t, packetsPerThread] {
+            PRNG prng(t + 1);
+            BlockyPacket packet;
+            for (size_t j = 0; j < packetsPerThread; j++) {
+                encoder.encode(packet, (t + j) % encoder.getNumGenerations(), prng);
+            }
+            delete [] packet.data;
+            delete [] packet.coeffs;
+        }));
+    }
+    for (size_t t = 0; t < numThreads; t++) {
+        threads[t].join();
+    }
+    gettimeofday(&end, NULL);
+
+    printf("ConcurrentEncode%s(%lu, %lu, %lu, %lu threads) - %lu MB/s\n", shared ? "Shared" : "", blockSize, blocksPerGeneration, dataLength, numThreads,
+           (blockSize * packetsPerThread * numThreads) / max(timeDelta(start, end), (size_t) 1));
+
+    delete [] data;
+}
+
+void benchConcurrentStore(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numThreads, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+    size_t count = blocksPerGeneration + 2;
+    vector<BlockyPacket> packets(count * encoder.getNumGenerations());
+    for (size_t j = 0; j < packets.size(); j++) {
+        encoder.encode(packets[j], j % encoder.getNumGenerations());
+    }
+
+    // Receive threads each take an interleaved share of the packets
+    struct timeval start, end;
+    size_t elapsed = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        decoder.setConcurrentStore();
+
+        gettimeofday(&start, NULL);
+        vector<thread> threads;
+        for (size_t t = 0; t < numThreads; t++) {
+            threads.push_back(thread([&decoder, &packets, t, numThreads] {
+                for (size_t j = t; j < packets.size(); j += numThreads) {
+                    decoder.store(packets[j]);
+                }
+            }));
+        }
+        for (size_t t = 0; t < numThreads; t++) {
+            threads[t].join();
+        }
+        gettimeofday(&end, NULL);
+        elapsed += timeDelta(start, end);
+    }
+
+    printf("ConcurrentStore(%lu, %lu, %lu, %lu threads) - %lu MB/s\n", blockSize, blocksPerGeneration, dataLength, numThreads, (dataLength * numIterations) / max(elapsed, (size_t) 1));
+
+    for (size_t j = 0; j < packets.size(); j++) {
+        delete [] packets[j].data;
+        delete [] packets[j].coeffs;
+    }
+    delete [] data;
+}
+
+void benchPipeline(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, bool pipelined, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    ofstream encfile("test.enc", ios::out|ios::binary);
+    encfile.write((char *) data, dataLength);
+    encfile.close();
+
+    // Ingest is the time the receiving thread is busy; total includes draining the pipeline
+    struct timeval start, end;
+    size_t ingestTime = 0, totalTime = 0, maxStoreTime = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        BlockyCoderFile encoder = BlockyCoderFile::createEncoder(blockSize, blocksPerGeneration, "test.enc");
+        BlockyCoderFile decoder = BlockyCoderFile::createDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec");
+        vector<BlockyPacket> packets((blocksPerGeneration + 2) * encoder.getNumGenerations());
+        for (size_t j = 0; j < packets.size(); j++) {
+            encoder.encode(packets[j], j / (blocksPerGeneration + 2));
+        }
+
+        gettimeofday(&start, NULL);
+        if (pipelined) {
+            decoder.startPipeline();
+        }
+
+        for (size_t j = 0; j < packets.size(); j++) {
+
+            struct timeval storeStart, storeEnd;
+            gettimeofday(&storeStart, NULL);
+            size_t generation = packets[j].generation;
+            if (decoder.store(packets[j]) && !pipelined && decoder.canDecodeGeneration(generation)) {
+                decoder.decodeGeneration(generation);
+                decoder.flushGeneration(generation);
+            }
+            gettimeofday(&storeEnd, NULL);
+            maxStoreTime = max(maxStoreTime, timeDelta(storeStart, storeEnd));
+        }
+        gettimeofday(&end, NULL);
+        ingestTime += timeDelta(start, end);
+
+        if (pipelined) {
+            decoder.finishPipeline();
+        }
+        gettimeofday(&end, NULL);
+        totalTime += timeDelta(start, end);
+
+        for (size_t j = 0; j < packets.size(); j++) {
+            delete [] packets[j].data;
+            delete [] packets[j].coeffs;
+        }
+    }
+
+    printf("Pipeline%s(%lu, %lu, %lu) - Ingest: %lu MB/s, Total: %lu MB/s, Longest store: %lu us\n", pipelined ? "" : "Inline", blockSize, blocksPerGeneration, dataLength,
+           (dataLength * numIterations) / max(ingestTime, (size_t) 1), (dataLength * numIterations) / max(totalTime, (size_t) 1), maxStoreTime);
+
+    remove("test.enc");
+    remove("test.dec");
+    delete [] data;
+}
+
+void benchStreamingEncoder(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t windowSize, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    ofstream encfile("test.enc", ios::out|ios::binary);
+    encfile.write((char *) data, dataLength);
+    encfile.close();
+
+    // A window of 0 reads the whole file up front
+    struct timeval start, first, end;
+    size_t firstTime = 0, totalTime = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        BlockyPacket packet;
+        gettimeofday(&start, NULL);
+        {
+            BlockyCoderFile encoder = windowSize ? BlockyCoderFile::createStreamingEncoder(blockSize, blocksPerGeneration, "test.enc", windowSize)
+                                                 : BlockyCoderFile::createEncoder(blockSize, blocksPerGeneration, "test.enc");
+            encoder.encode(packet, 0);
+            gettimeofday(&first, NULL);
+
+            for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+                for (size_t j = (i == 0) ? 1 : 0; j < blocksPerGeneration; j++) {
+                    encoder.encode(packet, i);
+                }
+            }
+        }
+        gettimeofday(&end, NULL);
+        firstTime += timeDelta(start, first);
+        totalTime += timeDelta(start, end);
+
+        delete [] packet.data;
+        delete [] packet.coeffs;
+    }
+
+    printf("StreamingEncoder(%lu, %lu, %lu, %lu) - First packet: %lu us, %lu MB/s\n", blockSize, blocksPerGeneration, dataLength, windowSize,
+           firstTime / numIterations, (dataLength * numIterations) / max(totalTime, (size_t) 1));
+
+    remove("test.enc");
+    delete [] data;
+}
+
+void benchStreamingDecoder(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, bool streaming, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+    vector<BlockyPacket> packets(blocksPerGeneration * encoder.getNumGenerations());
+    for (size_t j = 0; j < packets.size(); j++) {
+        encoder.encode(packets[j], j / blocksPerGeneration);
+    }
+
+    // Generations arrive in order and are flushed as they complete
+    struct timeval start, end;
+    size_t elapsed = 0, peak = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        gettimeofday(&start, NULL);
+        {
+            BlockyCoderFile decoder = streaming ? BlockyCoderFile::createStreamingDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec")
+                                                : BlockyCoderFile::createDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec");
+            for (size_t j = 0; j < packets.size(); j++) {
+                size_t generation = packets[j].generation;
+                if (decoder.store(packets[j]) && decoder.canDecodeGeneration(generation)) {
+                    size_t resident = 0;
+                    for (size_t i = 0; i < decoder.getNumGenerations(); i++) {
+                        resident += decoder.getGenerationResident(i) ? 1 : 0;
+                    }
+                    peak = max(peak, resident * blocksPerGeneration * blockSize);
+
+                    decoder.decodeGeneration(generation);
+                    decoder.flushGeneration(generation);
+                }
+            }
+        }
+        gettimeofday(&end, NULL);
+        elapsed += timeDelta(start, end);
+    }
+
+    printf("StreamingDecoder%s(%lu, %lu, %lu) - %lu MB/s, Peak data held: %lu KB\n", streaming ? "" : "Buffered", blockSize, blocksPerGeneration, dataLength,
+           (dataLength * numIterations) / max(elapsed, (size_t) 1), peak / 1024);
+
+    for (size_t j = 0; j < packets.size(); j++) {
+        delete [] packets[j].data;
+        delete [] packets[j].coeffs;
+    }
+    remove("test.dec");
+    delete [] data;
+}
+
+void benchStream(size_t blockSize, size_t blocksPerGeneration, size_t windowSize, size_t dataLength, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    // Appended in pieces of one block, each generation sent as it seals and delivered as it completes
+    struct timeval start, end;
+    size_t elapsed = 0, delivered = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        BlockyCoderStream encoder = BlockyCoderStream::createEncoder(blockSize, blocksPerGeneration, windowSize);
+        BlockyCoderStream decoder = BlockyCoderStream::createDecoder(blockSize, blocksPerGeneration, windowSize);
+        BlockyPacket packet;
+
+        gettimeofday(&start, NULL);
+        for (size_t offset = 0, sent = 0; offset < dataLength; offset += blockSize) {
+
+            encoder.append(&data[offset], min(blockSize, dataLength - offset));
+            if (offset + blockSize >= dataLength) {
+                encoder.seal();
+            }
+
+            for (; sent < encoder.getNextGeneration(); sent++) {
+                for (size_t j = 0; j < blocksPerGeneration + 1; j++) {
+                    encoder.encode(packet, sent);
+                    decoder.store(packet);
+                }
+            }
+
+            size_t length;
+            while (decoder.deliver(length) != NULL) {
+                delivered += length;
+            }
+        }
+        gettimeofday(&end, NULL);
+        elapsed += timeDelta(start, end);
+
+        delete [] packet.data;
+        delete [] packet.coeffs;
+    }
+
+    printf("Stream(%lu, %lu, %lu, %lu) - %lu MB/s\n", blockSize, blocksPerGeneration, windowSize, dataLength, delivered / max(elapsed, (size_t) 1));
+
+    delete [] data;
+}
+
+void benchFileSync(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, BlockyCoderFile::SyncMode mode, size_t interval, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+    vector<BlockyPacket> packets(blocksPerGeneration * encoder.getNumGenerations());
+    for (size_t j = 0; j < packets.size(); j++) {
+        encoder.setSystematic(j % blocksPerGeneration == 0);
+        encoder.encode(packets[j], j / blocksPerGeneration);
+    }
+
+    // Flushing runs until the decoder is closed, which syncs whatever is left
+    const char *names[] = {"None", "Every", "Group", "OnClose"};
+    struct timeval start, end;
+    size_t elapsed = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        {
+            BlockyCoderFile decoder = BlockyCoderFile::createDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec");
+            decoder.setSyncMode(mode, interval);
+            for (size_t j = 0; j < packets.size(); j++) {
+                decoder.store(packets[j]);
+            }
+            decoder.decode();
+
+            gettimeofday(&start, NULL);
+            decoder.flush();
+        }
+        gettimeofday(&end, NULL);
+        elapsed += timeDelta(start, end);
+    }
+
+    printf("FileSync%s(%lu, %lu, %lu, %lu) - FL %lu us, %lu MB/s\n", names[mode], blockSize, blocksPerGeneration, dataLength, interval,
+           elapsed / numIterations, (dataLength * numIterations) / max(elapsed, (size_t) 1));
+
+    for (size_t j = 0; j < packets.size(); j++) {
+        delete [] packets[j].data;
+        delete [] packets[j].coeffs;
+    }
+    remove("test.dec");
+    delete [] data;
+}
+
+void benchAsyncIO(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t windowSize, bool async, size_t numIterations)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    ofstream encfile("test.enc", ios::out|ios::binary);
+    encfile.write((char *) data, dataLength);
+    encfile.close();
+
+    // File to file through streaming coders, decoding and flushing each generation as it completes
+    bool available = true;
+    struct timeval start, end;
+    size_t elapsed = 0;
+    for (size_t k = 0; k < numIterations; k++) {
+
+        BlockyPacket packet;
+        gettimeofday(&start, NULL);
+        {
+            BlockyCoderFile encoder = BlockyCoderFile::createStreamingEncoder(blockSize, blocksPerGeneration, "test.enc", windowSize);
+            BlockyCoderFile decoder = BlockyCoderFile::createStreamingDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec");
+            encoder.setSystematic(true);
+            decoder.setSyncMode(BlockyCoderFile::SYNC_EVERY, 64);
+            if (async) {
+                available = encoder.setAsyncIO(true) && decoder.setAsyncIO(true);
+            }
+
+            for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+                for (size_t j = 0; j < blocksPerGeneration; j++) {
+                    encoder.encode(packet, i);
+                    decoder.store(packet);
+                }
+                decoder.decodeGeneration(i);
+                decoder.flushGeneration(i);
+            }
+            decoder.sync();
+        }
+        gettimeofday(&end, NULL);
+        elapsed += timeDelta(start, end);
+
+        delete [] packet.data;
+        delete [] packet.coeffs;
+    }
+
+    printf("AsyncIO%s(%lu, %lu, %lu, %lu) - %lu us, %lu MB/s\n", async ? (available ? "Uring" : "Unavailable") : "Sync", blockSize, blocksPerGeneration, dataLength, windowSize,
+           elapsed / numIterations, (dataLength * numIterations) / max(elapsed, (size_t) 1));
+
+    remove("test.enc");
+    remove("test.dec");
+    delete [] data;
+}
+
+template <typename B> void benchCoderMulti(vector<MultiTestCase> cases, const char *name, Coder::DecodingMode mode = Coder::ECHELON)
 {
 
     for (size_t i = 0; i < cases.size(); i++) {
-        benchCoder<B>(name, cases[i].blockSize, cases[i].blocksPerGeneration, cases[i].dataLength, cases[i].numIterations);
+        benchCoder<B>(name, cases[i].blockSize, cases[i].blocksPerGeneration, cases[i].dataLength, cases[i].numIterations, mode);
     }
 }
 
@@ -237,10 +1026,103 @@ int main() {
         {32, 16, 65537, 10},
         {32768, 16, 4*1048576, 10},
         {32768, 64, 1048576, 10},
+        {1024, 256, 4*1048576, 10},
     };
 
+    benchGF28(32768, 10000);
+
     benchCoderMulti<BlockyCoderMemory>(cases, "BlockyCoderMemory");
     benchCoderMulti<BlockyCoderFile>(cases, "BlockyCoderFile");
     benchCoderMulti<BlockyCoderMmap>(cases, "BlockyCoderMmap");
+    benchCoderMulti<BlockyCoderMemory>(cases, "BlockyCoderMemoryGaussJordan", Coder::GAUSS_JORDAN);
+    benchCoderMulti<BlockyCoderMemory>(cases, "BlockyCoderMemoryDeferred", Coder::DEFERRED);
+
+    const double lossRates[] = {0.0, 0.01, 0.05, 0.2};
+    for (size_t i = 0; i < sizeof(lossRates) / sizeof(lossRates[0]); i++) {
+        benchTransfer(32768, 64, 4*1048576, lossRates[i], false, false, 0, 10);
+        benchTransfer(32768, 64, 4*1048576, lossRates[i], true, false, 0, 10);
+    }
+
+    benchTransfer(1024, 256, 4*1048576, 0.05, false, false, 0, 10);
+    benchTransfer(1024, 256, 4*1048576, 0.05, false, true, 0, 10);
+
+    const size_t batchSizes[] = {1, 4, 16, 64};
+    for (size_t i = 0; i < sizeof(batchSizes) / sizeof(batchSizes[0]); i++) {
+        benchEncodeBatch(32768, 64, batchSizes[i], 1024 / batchSizes[i]);
+    }
+
+    for (size_t i = 0; i < sizeof(batchSizes) / sizeof(batchSizes[0]); i++) {
+        benchStoreBatch(32768, 64, batchSizes[i], 20);
+    }
+
+    const Coder::DecodingMode modes[] = {Coder::ECHELON, Coder::GAUSS_JORDAN, Coder::DEFERRED};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        benchCoderLayout(1024, 256, modes[i], false, 10);
+        benchCoderLayout(1024, 256, modes[i], true, 10);
+        benchCoderLayout(32768, 64, modes[i], false, 10);
+        benchCoderLayout(32768, 64, modes[i], true, 10);
+    }
+
+    benchRelay(1024, 256, false, 10);
+    benchRelay(1024, 256, true, 10);
+    benchRelay(32768, 64, false, 10);
+    benchRelay(32768, 64, true, 10);
+
+    const size_t threadCounts[] = {1, 2, 4, 8, 0};
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        size_t threads = threadCounts[i] ? threadCounts[i] : ThreadPool::getDefault().getNumThreads();
+        benchParallel(32768, 16, 16*1048576, threads, 5);
+    }
+
+    // A single generation, so only striping can use the threads
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        size_t threads = threadCounts[i] ? threadCounts[i] : ThreadPool::getDefault().getNumThreads();
+        benchParallel(32768, 64, 2*1048576, threads, 5);
+    }
+
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        size_t threads = threadCounts[i] ? threadCounts[i] : ThreadPool::getDefault().getNumThreads();
+        benchConcurrentEncode(32768, 64, 16*1048576, threads, 4096 / threads, false);
+        benchConcurrentEncode(32768, 64, 16*1048576, threads, 4096 / threads, true);
+    }
+
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        size_t threads = threadCounts[i] ? threadCounts[i] : ThreadPool::getDefault().getNumThreads();
+        benchConcurrentStore(32768, 16, 16*1048576, threads, 3);
+    }
+
+    benchPipeline(32768, 16, 16*1048576, false, 3);
+    benchPipeline(32768, 16, 16*1048576, true, 3);
+
+    const size_t windowSizes[] = {0, 1, 4, 16};
+    for (size_t i = 0; i < sizeof(windowSizes) / sizeof(windowSizes[0]); i++) {
+        benchStreamingEncoder(32768, 16, 64*1048576, windowSizes[i], 3);
+    }
+
+    benchStreamingDecoder(32768, 16, 16*1048576, false, 3);
+    benchStreamingDecoder(32768, 16, 16*1048576, true, 3);
+
+    benchStream(1024, 64, 4, 16*1048576, 3);
+    benchStream(32768, 16, 4, 16*1048576, 3);
+
+    // Many small generations, where a sync per generation dominates
+    benchFileSync(1024, 16, 16*1048576, BlockyCoderFile::SYNC_EVERY, 1, 3);
+    benchFileSync(1024, 16, 16*1048576, BlockyCoderFile::SYNC_EVERY, 64, 3);
+    benchFileSync(1024, 16, 16*1048576, BlockyCoderFile::SYNC_GROUP, 10, 3);
+    benchFileSync(1024, 16, 16*1048576, BlockyCoderFile::SYNC_ON_CLOSE, 1, 3);
+    benchFileSync(1024, 16, 16*1048576, BlockyCoderFile::NO_SYNC, 1, 3);
+
+    benchAsyncIO(32768, 16, 64*1048576, 4, false, 3);
+    benchAsyncIO(32768, 16, 64*1048576, 4, true, 3);
+
+    benchRankTracker(16, 10000);
+    benchRankTracker(64, 1000);
+    benchRankTracker(256, 100);
+
+    // Coefficient density against overhead and throughput
+    const size_t densities[] = {2, 4, 8, 16, 32, 0};
+    for (size_t i = 0; i < sizeof(densities) / sizeof(densities[0]); i++) {
+        benchTransfer(32768, 64, 4*1048576, 0.05, false, false, densities[i], 10);
+    }
 
 }
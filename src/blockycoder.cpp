@@ -7,9 +7,81 @@
 */
 
 #include "blockycoder.h"
+#include "boundedqueue.h"
+#include <thread>
 
 using namespace blocky;
 
+struct BlockyCoder::Pipeline {
+
+    /*! @brief Constructor
+        @param[in] numGenerations The number of generations, which bounds both queues
+    */
+    explicit Pipeline(size_t numGenerations) :
+        decodeQueue(numGenerations),
+        flushQueue(numGenerations),
+        queued(new std::atomic<bool>[numGenerations]),
+        flushed(0),
+        failed(false)
+    {
+
+        for (size_t i = 0; i < numGenerations; i++) {
+            queued[i] = false;
+        }
+
+    }
+
+    /*! @brief Destructor */
+    ~Pipeline()
+    {
+
+        delete [] queued;
+
+    }
+
+    /*! @brief Queues a full generation for decoding, unless it has been queued already
+        @param[in] generation The generation
+
+        The store completing a generation and the scan in startPipeline() can both see it full.
+    */
+    void queue(size_t generation)
+    {
+
+        bool expected = false;
+        if (queued[generation].compare_exchange_strong(expected, true)) {
+            decodeQueue.push(generation);
+        }
+
+    }
+
+    /*! @brief Generations at full rank, waiting to be decoded */
+    BoundedQueue<size_t> decodeQueue;
+
+    /*! @brief Decoded generations, waiting to be flushed */
+    BoundedQueue<size_t> flushQueue;
+
+    /*! @brief Whether each generation has been queued for decoding */
+    std::atomic<bool> *queued;
+
+    /*! @brief The decode stage */
+    std::thread decodeThread;
+
+    /*! @brief The flush stage */
+    std::thread flushThread;
+
+    /*! @brief The number of generations flushed */
+    std::atomic<size_t> flushed;
+
+    /*! @brief Whether a generation failed to decode or flush */
+    std::atomic<bool> failed;
+
+    /*! @brief The first exception thrown by the decode stage */
+    std::exception_ptr decodeError;
+
+    /*! @brief The first exception thrown by the flush stage */
+    std::exception_ptr flushError;
+};
+
 BlockyCoder::BlockyCoder() :
     blockSize(0),
     blocksPerGeneration(0),
@@ -20,9 +92,15 @@ BlockyCoder::BlockyCoder() :
     decoded(false),
     partialLastBlock(false),
     partialLastGeneration(0),
+    seeded(false),
     blocks(NULL),
     buffer(NULL),
-    coders(NULL)
+    coders(NULL),
+    pool(NULL),
+    locks(NULL),
+    ranks(NULL),
+    settled(NULL),
+    pipeline(NULL)
 {
 
 }
@@ -37,9 +115,15 @@ BlockyCoder::BlockyCoder(size_t _blockSize, size_t _blocksPerGeneration, size_t
     decoded(false),
     partialLastBlock(false),
     partialLastGeneration(false),
+    seeded(false),
     blocks(NULL),
     buffer(NULL),
-    coders(NULL)
+    coders(NULL),
+    pool(NULL),
+    locks(NULL),
+    ranks(NULL),
+    settled(NULL),
+    pipeline(NULL)
 {
 
     if ((dataLength % blockSize) != 0) {
@@ -67,10 +151,12 @@ BlockyCoder::BlockyCoder(BlockyCoder&& other)
 BlockyCoder::~BlockyCoder()
 {
 
+    stopPipeline();
+
     if (blocks) {
 
         // Have we allocated a separate last block?
-        if (blocks[numBlocks-1] != &buffer[(numBlocks - 1) * blockSize]) {
+        if (buffer && blocks[numBlocks-1] != &buffer[(numBlocks - 1) * blockSize]) {
             delete [] blocks[numBlocks - 1];
         }
 
@@ -81,6 +167,15 @@ BlockyCoder::~BlockyCoder()
         delete [] coders;
     }
 
+    if (locks) {
+        delete [] locks;
+    }
+
+    if (ranks) {
+        delete [] ranks;
+        delete [] settled;
+    }
+
 }
 
 BlockyCoder& BlockyCoder::operator =(BlockyCoder& other)
@@ -112,75 +207,340 @@ void BlockyCoder::swap(BlockyCoder& first, BlockyCoder& second)
     swap(first.decoded, second.decoded);
     swap(first.partialLastBlock, second.partialLastBlock);
     swap(first.partialLastGeneration, second.partialLastGeneration);
+    swap(first.seeded, second.seeded);
     swap(first.blocks, second.blocks);
     swap(first.buffer, second.buffer);
     swap(first.coders, second.coders);
+    swap(first.pool, second.pool);
+    swap(first.locks, second.locks);
+    swap(first.ranks, second.ranks);
+    swap(first.settled, second.settled);
+
+    // Atomics can't be swapped, and the pipeline isn't running during a swap
+    Pipeline *pipeline = first.pipeline;
+    first.pipeline = second.pipeline.load();
+    second.pipeline = pipeline;
 
 }
 
 bool BlockyCoder::store(BlockyPacket& packet) 
 {
 
-    if (packet.generation > getNumGenerations()) {
+    if (!checkPacket(packet) || isGenerationFull(packet.generation)) {
         return false;
     }
 
-    if (packet.numBlocks != coders[packet.generation].getNumBlocks()) {
-        return false;
+    std::unique_lock<std::mutex> lock = lockGeneration(packet.generation);
+    if (coders[packet.generation].getRank() == 0) {
+        allocateGeneration(packet.generation);
     }
 
-    if (coders[packet.generation].canDecode()) {
-        return true;
+    bool helpful;
+    if (packet.seeded) {
+        helpful = coders[packet.generation].storeSeeded(packet.data, packet.seed);
+    } else {
+        helpful = coders[packet.generation].store(packet.data, packet.coeffs);
     }
 
-    size_t blockNo = (blocksPerGeneration * packet.generation) + coders[packet.generation].getRank();
-    size_t blockSize = coders[packet.generation].getBlockSize();
+    updateRank(packet.generation, helpful);
+    return helpful;
+
+}
+
+bool BlockyCoder::setConcurrentStore()
+{
+
+    for (size_t i = 0; i < getNumGenerations(); i++) {
+        if (coders[i].getRank() != 0) {
+            return false;
+        }
+    }
+
+    createLocks();
+    return true;
+
+}
+
+void BlockyCoder::createLocks()
+{
+
+    if (locks != NULL) {
+        return;
+    }
+
+    locks = new std::mutex[getNumGenerations()];
+    ranks = new std::atomic<size_t>[getNumGenerations()];
+    settled = new std::atomic<bool>[getNumGenerations()];
+    for (size_t i = 0; i < getNumGenerations(); i++) {
+        ranks[i] = coders[i].getRank();
+        settled[i] = coders[i].getDecoded();
+    }
+
+}
+
+void BlockyCoder::updateRank(size_t generation, bool helpful)
+{
+
+    if (ranks == NULL) {
+        return;
+    }
+
+    ranks[generation] = coders[generation].getRank();
+
+    // Only the store that completes a generation sees it become full, though the start of the pipeline may too
+    Pipeline *stages = pipeline;
+    if (stages && helpful && coders[generation].canDecode()) {
+        stages->queue(generation);
+    }
+
+}
+
+std::unique_lock<std::mutex> BlockyCoder::lockGeneration(size_t generation) const
+{
+
+    if (locks == NULL) {
+        return std::unique_lock<std::mutex>();
+    }
+
+    return std::unique_lock<std::mutex>(locks[generation]);
+
+}
+
+bool BlockyCoder::startPipeline()
+{
 
-    if (packet.blockSize != blockSize) {
+    if (pipeline != NULL) {
         return false;
     }
 
-    memcpy(blocks[blockNo], packet.data, blockSize);
+    createLocks();
+    Pipeline *stages = new Pipeline(getNumGenerations());
+
+    stages->decodeThread = std::thread([this, stages] {
+
+        size_t generation;
+        while (stages->decodeQueue.pop(generation)) {
+            try {
+                if (decodeGeneration(generation)) {
+                    stages->flushQueue.push(generation);
+                } else {
+                    stages->failed = true;
+                }
+            } catch (...) {
+                stages->failed = true;
+                if (!stages->decodeError) {
+                    stages->decodeError = std::current_exception();
+                }
+            }
+        }
+        stages->flushQueue.close();
+    });
+
+    stages->flushThread = std::thread([this, stages] {
+
+        size_t generation;
+        while (stages->flushQueue.pop(generation)) {
+            try {
+                if (flushGeneration(generation)) {
+                    stages->flushed++;
+                } else {
+                    stages->failed = true;
+                }
+            } catch (...) {
+                stages->failed = true;
+                if (!stages->flushError) {
+                    stages->flushError = std::current_exception();
+                }
+            }
+        }
+    });
 
-    return coders[packet.generation].store(blocks[blockNo], packet.coeffs);
+    // Generations completed before the pipeline started; a store completing one from now on queues it itself
+    pipeline = stages;
+    for (size_t i = 0; i < getNumGenerations(); i++) {
+        if (isGenerationFull(i)) {
+            stages->queue(i);
+        }
+    }
+
+    return true;
 
 }
 
-bool BlockyCoder::decodeGeneration(size_t generation) 
+bool BlockyCoder::finishPipeline()
 {
 
-    if (generation > getNumGenerations()) {
+    Pipeline *stages = pipeline;
+    if (stages == NULL) {
         return false;
     }
 
-    if (!canDecodeGeneration(generation)) {
+    stages->decodeQueue.close();
+    stages->decodeThread.join();
+    stages->flushThread.join();
+
+    bool retval = !stages->failed && stages->flushed == getNumGenerations();
+    std::exception_ptr error = stages->decodeError ? stages->decodeError : stages->flushError;
+    pipeline = NULL;
+    delete stages;
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    return retval;
+
+}
+
+void BlockyCoder::stopPipeline()
+{
+
+    try {
+        finishPipeline();
+    } catch (...) {
+    }
+
+}
+
+size_t BlockyCoder::getGenerationsFlushed()
+{
+
+    Pipeline *stages = pipeline;
+    return stages ? stages->flushed.load() : 0;
+
+}
+
+bool BlockyCoder::storeOwned(BlockyPacket& packet)
+{
+
+    if (!checkPacket(packet) || isGenerationFull(packet.generation)) {
         return false;
     }
 
-    return coders[generation].decode();
+    std::unique_lock<std::mutex> lock = lockGeneration(packet.generation);
+    if (coders[packet.generation].getRank() == 0) {
+        allocateGeneration(packet.generation);
+    }
+
+    bool helpful, adopted;
+    if (packet.seeded) {
+        helpful = coders[packet.generation].storeSeeded(packet.data, packet.seed, adopted);
+    } else {
+        helpful = coders[packet.generation].store(packet.data, packet.coeffs, adopted);
+    }
+    updateRank(packet.generation, helpful);
+
+    if (adopted) {
+        packet.data = NULL;
+    }
+
+    return helpful;
 
 }
 
-bool BlockyCoder::decode() 
+size_t BlockyCoder::storeBatch(BlockyPacket *packets, size_t count)
 {
 
-    bool retval = true;
+    uint8_t **data = new uint8_t*[count];
+    uint8_t **coeffs = new uint8_t*[count];
+    uint8_t *expanded = new uint8_t[count * blocksPerGeneration];
+    size_t helpful = 0;
+
+    for (size_t j = 0; j < count; ) {
+
+        size_t generation = packets[j].generation;
+        size_t run = 0;
+        for (; j < count && packets[j].generation == generation; j++) {
+
+            BlockyPacket& packet = packets[j];
+            if (!checkPacket(packet)) {
+                continue;
+            }
+
+            data[run] = packet.data;
+            if (packet.seeded) {
+                coeffs[run] = &expanded[run * blocksPerGeneration];
+                coders[generation].expandSeed(packet.seed, coeffs[run]);
+            } else {
+                coeffs[run] = packet.coeffs;
+            }
+            run++;
+        }
 
-    for (size_t i = 0; i < getNumGenerations(); i++) {
+        if (run > 0 && !isGenerationFull(generation)) {
+            std::unique_lock<std::mutex> lock = lockGeneration(generation);
+            if (coders[generation].getRank() == 0) {
+                allocateGeneration(generation);
+            }
 
-        if (!decodeGeneration(i)) {
-            retval = false;
+            size_t stored = coders[generation].storeBatch(data, coeffs, run);
+            updateRank(generation, stored > 0);
+            helpful += stored;
         }
     }
 
-    return retval;
+    delete [] data;
+    delete [] coeffs;
+    delete [] expanded;
+
+    return helpful;
+
+}
+
+bool BlockyCoder::checkPacket(const BlockyPacket& packet)
+{
+
+    if (packet.generation >= getNumGenerations()) {
+        return false;
+    }
+
+    if (packet.numBlocks != coders[packet.generation].getNumBlocks()) {
+        return false;
+    }
+
+    if (packet.blockSize != coders[packet.generation].getBlockSize()) {
+        return false;
+    }
+
+    return true;
+
+}
+
+bool BlockyCoder::decodeGeneration(size_t generation) 
+{
+
+    if (generation >= getNumGenerations()) {
+        return false;
+    }
+
+    if (!canDecodeGeneration(generation)) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock = lockGeneration(generation);
+    if (!coders[generation].decode()) {
+        return false;
+    }
+
+    // From here on the blocks are only read, so reentrant encoding stops locking
+    if (settled) {
+        settled[generation] = true;
+    }
+    return true;
+
+}
+
+bool BlockyCoder::decode() 
+{
+
+    return forEachGeneration([this](size_t generation) { return decodeGeneration(generation); });
 
 }
 
 bool BlockyCoder::encode(BlockyPacket& packet, size_t generation) 
 {
 
-    if (generation > getNumGenerations()) {
+    if (generation >= getNumGenerations()) {
         return false;
     }
 
@@ -192,6 +552,16 @@ bool BlockyCoder::encode(BlockyPacket& packet, size_t generation)
         packet.data = new uint8_t[packet.blockSize];
     }
 
+    if (!loadGeneration(generation)) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock = lockGeneration(generation);
+    packet.seeded = seeded && coders[generation].encodeSeeded(packet.data, packet.seed);
+    if (packet.seeded) {
+        return true;
+    }
+
     if (packet.coeffs == NULL) {
         packet.coeffs = new uint8_t[packet.numBlocks];
     }
@@ -200,26 +570,234 @@ bool BlockyCoder::encode(BlockyPacket& packet, size_t generation)
 
 }
 
+bool BlockyCoder::encode(BlockyPacket& packet, size_t generation, PRNG& prng) const
+{
+
+    if (generation >= numGenerations || !canEncodeConcurrently()) {
+        return false;
+    }
+
+    const Coder& coder = coders[generation];
+    packet.generation = generation;
+    packet.numBlocks = coder.getNumBlocks();
+    packet.blockSize = coder.getBlockSize();
+
+    if (packet.data == NULL) {
+        packet.data = new uint8_t[packet.blockSize];
+    }
+
+    // The coefficients are expanded for seeded packets too, so they serve as scratch
+    if (packet.coeffs == NULL) {
+        packet.coeffs = new uint8_t[packet.numBlocks];
+    }
+
+    // Only a generation that can still change needs its lock
+    std::unique_lock<std::mutex> lock;
+    if (!isGenerationSettled(generation)) {
+        lock = lockGeneration(generation);
+    }
+    packet.seeded = seeded && coder.encodeSeeded(packet.data, packet.seed, packet.coeffs, prng);
+    if (packet.seeded) {
+        return true;
+    }
+
+    return coder.encode(packet.data, packet.coeffs, prng);
+
+}
+
+bool BlockyCoder::encodeBatch(size_t generation, size_t count, BlockyPacket *packets)
+{
+
+    if (generation >= getNumGenerations()) {
+        return false;
+    }
+
+    if (!loadGeneration(generation)) {
+        return false;
+    }
+
+    Coder& coder = coders[generation];
+    uint8_t **data = new uint8_t*[count];
+    uint8_t **coeffs = new uint8_t*[count];
+    uint32_t *seeds = new uint32_t[count];
+
+    for (size_t j = 0; j < count; j++) {
+
+        BlockyPacket& packet = packets[j];
+        packet.generation = generation;
+        packet.numBlocks = coder.getNumBlocks();
+        packet.blockSize = coder.getBlockSize();
+
+        if (packet.data == NULL) {
+            packet.data = new uint8_t[packet.blockSize];
+        }
+
+        if (packet.coeffs == NULL) {
+            packet.coeffs = new uint8_t[packet.numBlocks];
+        }
+
+        data[j] = packet.data;
+        coeffs[j] = packet.coeffs;
+    }
+
+    std::unique_lock<std::mutex> lock = lockGeneration(generation);
+    bool retval;
+    size_t unseeded = count;
+    if (seeded) {
+        retval = coder.encodeSeededBatch(data, coeffs, seeds, count, unseeded);
+    } else {
+        retval = coder.encodeBatch(data, coeffs, count);
+    }
+
+    for (size_t j = 0; j < count; j++) {
+        packets[j].seeded = (j >= unseeded);
+        if (packets[j].seeded) {
+            packets[j].seed = seeds[j];
+        }
+    }
+
+    delete [] data;
+    delete [] coeffs;
+    delete [] seeds;
+
+    return retval;
+
+}
+
+bool BlockyCoder::encodeGenerations(size_t count, BlockyPacket *packets)
+{
+
+    if (!canEncodeConcurrently()) {
+
+        bool retval = true;
+        for (size_t i = 0; i < getNumGenerations(); i++) {
+            if (!encodeBatch(i, count, &packets[i * count])) {
+                retval = false;
+            }
+        }
+        return retval;
+    }
+
+    return forEachGeneration([this, count, packets](size_t generation) {
+        return encodeBatch(generation, count, &packets[generation * count]);
+    });
+
+}
+
+void BlockyCoder::setSystematic(bool systematic)
+{
+
+    for (size_t i = 0; i < getNumGenerations(); i++) {
+        coders[i].setSystematic(systematic);
+    }
+
+}
+
+void BlockyCoder::setNonzeros(size_t nonzeros)
+{
+
+    for (size_t i = 0; i < getNumGenerations(); i++) {
+        coders[i].setNonzeros(nonzeros);
+    }
+
+}
+
+void BlockyCoder::setSeed(uint64_t seed)
+{
+
+    PRNG prng(seed);
+    for (size_t i = 0; i < getNumGenerations(); i++) {
+        coders[i].setSeed(((uint64_t) prng.next() << 32) | prng.next());
+    }
+
+}
+
 bool BlockyCoder::flushGeneration(size_t generation)
 {
     (void) generation;
     return true;
 }
 
+bool BlockyCoder::flushBlock(size_t generation, size_t block)
+{
+
+    return coders[generation].isBlockDecoded(block);
+
+}
+
+bool BlockyCoder::setDecodingMode(Coder::DecodingMode mode)
+{
+
+    for (size_t i = 0; i < getNumGenerations(); i++) {
+        if (coders[i].getRank() != 0) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < getNumGenerations(); i++) {
+        coders[i].setDecodingMode(mode);
+    }
+
+    return true;
+
+}
+
 bool BlockyCoder::flush()
 {
 
-    bool retval = true;
+    if (!canFlushConcurrently()) {
+
+        bool retval = true;
+        for (size_t i = 0; i < getNumGenerations(); i++) {
+            if (!flushGeneration(i)) {
+                retval = false;
+            }
+        }
+        return retval;
+    }
+
+    return forEachGeneration([this](size_t generation) { return flushGeneration(generation); });
+
+}
 
+void BlockyCoder::setThreadPool(ThreadPool *_pool)
+{
+
+    pool = _pool;
     for (size_t i = 0; i < getNumGenerations(); i++) {
+        coders[i].setThreadPool(pool);
+    }
 
-        if (!flushGeneration(i)) {
-            retval = false;
+}
+
+bool BlockyCoder::forEachGeneration(const std::function<bool(size_t)>& body)
+{
+
+    // Too few generations would leave threads idle; each one stripes its payload work instead
+    if (pool == NULL || getNumGenerations() < pool->getNumThreads()) {
+
+        bool retval = true;
+        for (size_t i = 0; i < getNumGenerations(); i++) {
+            if (!body(i)) {
+                retval = false;
+            }
         }
+        return retval;
+    }
 
+    // One flag per generation, so tasks share nothing
+    bool *results = new bool[getNumGenerations()];
+    try {
+        pool->parallelFor(getNumGenerations(), [&body, results](size_t i) { results[i] = body(i); });
+    } catch (...) {
+        delete [] results;
+        throw;
     }
 
+    bool retval = std::all_of(results, results + getNumGenerations(), [](bool result) { return result; });
+    delete [] results;
     return retval;
+
 }
 
 size_t BlockyCoder::getGenerationsCompleted() 
@@ -227,7 +805,7 @@ size_t BlockyCoder::getGenerationsCompleted()
 
     size_t result = 0;
     for (size_t i = 0; i < getNumGenerations(); i++) {
-        if (coders[i].canDecode()) {
+        if (canDecodeGeneration(i)) {
             result++;
         }
     }
@@ -269,9 +847,23 @@ void BlockyCoder::createDecoders()
     coders = new Coder[numGenerations];
     for (size_t i = 0; i < numGenerations; i++) {
         if ((i == numGenerations-1) && partialLastGeneration) {
-            coders[i] = Coder::createDecoder(blockSize, numBlocks - (i * blocksPerGeneration));
+            coders[i] = Coder::createDecoder(blockSize, numBlocks - (i * blocksPerGeneration), &blocks[i * blocksPerGeneration]);
+        } else {
+            coders[i] = Coder::createDecoder(blockSize, blocksPerGeneration, &blocks[i * blocksPerGeneration]);
+        }
+    }
+
+}
+
+void BlockyCoder::createRecoders()
+{
+
+    coders = new Coder[numGenerations];
+    for (size_t i = 0; i < numGenerations; i++) {
+        if ((i == numGenerations-1) && partialLastGeneration) {
+            coders[i] = Coder::createRecoder(blockSize, numBlocks - (i * blocksPerGeneration));
         } else {
-            coders[i] = Coder::createDecoder(blockSize, blocksPerGeneration);
+            coders[i] = Coder::createRecoder(blockSize, blocksPerGeneration);
         }
     }
 
@@ -7,12 +7,187 @@
 */
 
 #include "blockycoderfile.h"
+#include "iouring.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
 #include <unistd.h>
 
 using namespace blocky;
 
+namespace {
+
+/*  Marks the tag of a read, whose low bits are the window slot; a write's tag is its generation. */
+const uint64_t READ_TAG = (uint64_t) 1 << 63;
+
+/*  The most requests an asynchronous coder keeps in flight. */
+const size_t ASYNC_DEPTH = 64;
+
+}
+
+struct BlockyCoderFile::AsyncIO {
+
+    /*! @brief Sets up the ring
+        @param[in] entries The number of requests that can be in flight at once
+        @param[in] numSlots The number of window slots
+    */
+    AsyncIO(unsigned entries, size_t numSlots) :
+        ring(entries),
+        error(0),
+        slotPending(NULL),
+        aheadOf((size_t) -1)
+    {
+
+        if (numSlots > 0) {
+            slotPending = new bool[numSlots];
+            for (size_t i = 0; i < numSlots; i++) {
+                slotPending[i] = false;
+            }
+        }
+
+    }
+
+    /*! @brief Destructor, after which the ring waits for the requests in flight */
+    ~AsyncIO()
+    {
+
+        delete [] slotPending;
+
+    }
+
+    /*! @brief The ring */
+    IoUring ring;
+
+    /*! @brief Guards the ring and the state below, for flushes and syncs from different threads */
+    std::mutex mutex;
+
+    /*! @brief The errno of the first failed write not reported yet, 0 if none */
+    int error;
+
+    /*! @brief Whether a read into each window slot is in flight */
+    bool *slotPending;
+
+    /*! @brief The generation reads were last queued after */
+    size_t aheadOf;
+};
+
+struct BlockyCoderFile::SyncTimer {
+
+    /*! @brief Starts syncing in the background
+        @param[in] _fd The file descriptor
+        @param[in] _interval The milliseconds between syncs
+        @param[in] _asyncIO The asynchronous I/O whose writes are synced, NULL if none
+    */
+    SyncTimer(int _fd, size_t _interval, AsyncIO *_asyncIO) :
+        fd(_fd),
+        interval(_interval),
+        dirty(false),
+        error(0),
+        stopping(false),
+        asyncIO(_asyncIO)
+    {
+
+        thread = std::thread([this] {
+
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping) {
+                condition.wait_for(lock, interval);
+                if (!dirty.exchange(false)) {
+                    continue;
+                }
+
+                // Writes the kernel is still running are not covered, so they get the next sync;
+                // flushing marks dirty after queueing, so later writes are never missed
+                if (asyncIO) {
+                    std::lock_guard<std::mutex> asyncLock(asyncIO->mutex);
+                    if (asyncIO->ring.getRunning() > 0) {
+                        dirty = true;
+                    }
+                }
+
+                if (fdatasync(fd)) {
+                    error = errno;
+                }
+            }
+        });
+
+    }
+
+    /*! @brief Stops syncing, with a last sync if anything is left */
+    ~SyncTimer()
+    {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_one();
+        thread.join();
+
+        if (dirty && fdatasync(fd)) {
+            error = errno;
+        }
+
+    }
+
+    /*! @brief Sets the asynchronous I/O whose writes are synced
+        @param[in] _asyncIO The asynchronous I/O, NULL if none
+
+        Called before it is deleted, so the thread never sees it half gone.
+    */
+    void watch(AsyncIO *_asyncIO)
+    {
+
+        std::lock_guard<std::mutex> lock(mutex);
+        asyncIO = _asyncIO;
+
+    }
+
+    /*! @brief The file descriptor */
+    int fd;
+
+    /*! @brief The time between syncs */
+    std::chrono::milliseconds interval;
+
+    /*! @brief Whether anything was flushed since the last sync */
+    std::atomic<bool> dirty;
+
+    /*! @brief The errno of the first failed sync, 0 if none failed */
+    std::atomic<int> error;
+
+    /*! @brief Whether the timer is stopping, guarded by mutex */
+    bool stopping;
+
+    /*! @brief The asynchronous I/O whose writes are synced, NULL if none, guarded by mutex */
+    AsyncIO *asyncIO;
+
+    /*! @brief Guards stopping and asyncIO */
+    std::mutex mutex;
+
+    /*! @brief Wakes the thread to stop */
+    std::condition_variable condition;
+
+    /*! @brief The thread */
+    std::thread thread;
+};
+
 BlockyCoderFile::BlockyCoderFile() :
-    BlockyCoder()
+    BlockyCoder(),
+    file(NULL),
+    fd(-1),
+    windowSize(0),
+    window(NULL),
+    slotGenerations(NULL),
+    slotTimes(NULL),
+    windowClock(0),
+    generationBuffers(NULL),
+    syncMode(SYNC_EVERY),
+    syncInterval(1),
+    unsynced(0),
+    syncTimer(NULL),
+    asyncIO(NULL)
 {
 
 }
@@ -20,13 +195,72 @@ BlockyCoderFile::BlockyCoderFile() :
 BlockyCoderFile::BlockyCoderFile(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength, string _filePath) :
     BlockyCoder(_blockSize, _blocksPerGeneration, _dataLength),
     filePath(_filePath),
-    file(NULL)
+    file(NULL),
+    fd(-1),
+    windowSize(0),
+    window(NULL),
+    slotGenerations(NULL),
+    slotTimes(NULL),
+    windowClock(0),
+    generationBuffers(NULL),
+    syncMode(SYNC_EVERY),
+    syncInterval(1),
+    unsynced(0),
+    syncTimer(NULL),
+    asyncIO(NULL)
 {
+
     buffer = new uint8_t[bufferSize];
     createBlocks(false);
 
 }
 
+BlockyCoderFile::BlockyCoderFile(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength, string _filePath, StreamingMode _streamingMode, size_t _windowSize) :
+    BlockyCoder(_blockSize, _blocksPerGeneration, _dataLength),
+    filePath(_filePath),
+    file(NULL),
+    fd(-1),
+    windowSize(_streamingMode == WINDOWED ? max(_windowSize, (size_t) 1) : 0),
+    window(NULL),
+    slotGenerations(NULL),
+    slotTimes(NULL),
+    windowClock(0),
+    generationBuffers(NULL),
+    syncMode(SYNC_EVERY),
+    syncInterval(1),
+    unsynced(0),
+    syncTimer(NULL),
+    asyncIO(NULL)
+{
+
+    if (_streamingMode == ON_ARRIVAL) {
+        generationBuffers = new uint8_t*[numGenerations];
+        for (size_t i = 0; i < numGenerations; i++) {
+            generationBuffers[i] = NULL;
+        }
+
+        blocks = new uint8_t*[numBlocks];
+        for (size_t i = 0; i < numBlocks; i++) {
+            blocks[i] = NULL;
+        }
+        return;
+    }
+
+    buffer = new uint8_t[windowSize * blocksPerGeneration * blockSize];
+    window = new uint8_t*[windowSize * blocksPerGeneration];
+    for (size_t i = 0; i < windowSize * blocksPerGeneration; i++) {
+        window[i] = &buffer[i * blockSize];
+    }
+
+    slotGenerations = new size_t[windowSize];
+    slotTimes = new size_t[windowSize];
+    for (size_t i = 0; i < windowSize; i++) {
+        slotGenerations[i] = numGenerations;
+        slotTimes[i] = 0;
+    }
+
+}
+
 BlockyCoderFile::BlockyCoderFile(BlockyCoderFile&& other)
     : BlockyCoderFile()
 {
@@ -38,10 +272,36 @@ BlockyCoderFile::BlockyCoderFile(BlockyCoderFile&& other)
 BlockyCoderFile::~BlockyCoderFile()
 {
 
+    stopPipeline();
+
+    // The kernel may still be using the buffers
+    if (asyncIO) {
+        drainIO();
+        if (syncTimer) {
+            syncTimer->watch(NULL);
+        }
+        delete asyncIO;
+        asyncIO = NULL;
+    }
+    syncOnClose();
+
     if (buffer) {
         delete [] buffer;
     }
 
+    if (window) {
+        delete [] window;
+        delete [] slotGenerations;
+        delete [] slotTimes;
+    }
+
+    if (generationBuffers) {
+        for (size_t i = 0; i < numGenerations; i++) {
+            delete [] generationBuffers[i];
+        }
+        delete [] generationBuffers;
+    }
+
     if (file) {
         fclose(file);
         file = NULL;
@@ -72,6 +332,21 @@ void BlockyCoderFile::swap(BlockyCoderFile& first, BlockyCoderFile& second)
     swap(first.filePath, second.filePath);
     swap(first.file, second.file);
     swap(first.fd, second.fd);
+    swap(first.windowSize, second.windowSize);
+    swap(first.window, second.window);
+    swap(first.slotGenerations, second.slotGenerations);
+    swap(first.slotTimes, second.slotTimes);
+    swap(first.windowClock, second.windowClock);
+    swap(first.generationBuffers, second.generationBuffers);
+    swap(first.syncMode, second.syncMode);
+    swap(first.syncInterval, second.syncInterval);
+    swap(first.syncTimer, second.syncTimer);
+    swap(first.asyncIO, second.asyncIO);
+
+    // Atomics can't be swapped, and nothing flushes during a swap
+    size_t unsynced = first.unsynced;
+    first.unsynced = second.unsynced.load();
+    second.unsynced = unsynced;
 
 }
 
@@ -82,20 +357,122 @@ bool BlockyCoderFile::flushGeneration(size_t generation)
         return false;
     }
 
+    // A streaming encoder has nothing the file does not hold already
+    if (windowSize > 0) {
+        return true;
+    }
+
     size_t offset = generation * blocksPerGeneration * blockSize;
-    if (fseek(file, offset, SEEK_SET)) {
-        throw system_error(errno, system_category());
+    uint8_t *data = &buffer[offset];
+    if (generationBuffers) {
+
+        // Written out and released before
+        if (generationBuffers[generation] == NULL) {
+            return true;
+        }
+        data = generationBuffers[generation];
     }
 
-    if (fwrite(&buffer[generation * blocksPerGeneration * blockSize], blockSize, coders[generation].getNumBlocks(), file) != coders[generation].getNumBlocks()) {
-        throw system_error(errno, system_category());
+    // The padding of the last block stays out of the file
+    size_t length = min(coders[generation].getNumBlocks() * blockSize, dataLength - offset);
+    if (asyncIO) {
+
+        std::lock_guard<std::mutex> lock(asyncIO->mutex);
+        pollIO();
+
+        // A full ring makes room by finishing a write, and a broken one falls back to writing here
+        bool queued;
+        while (!(queued = asyncIO->ring.submitWrite(fd, data, length, offset, generation)) && waitIO()) {
+        }
+
+        if (!queued) {
+            writeAt(data, length, offset);
+            completeIO(generation, (int) length);
+        }
+
+        syncFlushed();
+        throwIOError();
+        return true;
     }
 
-    if (fflush(file)) {
-        throw system_error(errno, system_category());
+    writeAt(data, length, offset);
+    syncFlushed();
+
+    if (generationBuffers) {
+        delete [] generationBuffers[generation];
+        generationBuffers[generation] = NULL;
+    }
+
+    return true;
+
+}
+
+bool BlockyCoderFile::flushBlock(size_t generation, size_t block)
+{
+
+    if (!coders[generation].isBlockDecoded(block)) {
+        return false;
+    }
+
+    if (windowSize > 0) {
+        return true;
+    }
+
+    // The data is made visible to readers of the file, flushGeneration() makes it durable
+    size_t offset = ((generation * blocksPerGeneration) + block) * blockSize;
+    size_t length = min(blockSize, dataLength - offset);
+    uint8_t *data = &buffer[offset];
+    if (generationBuffers) {
+        if (generationBuffers[generation] == NULL) {
+            return true;
+        }
+        data = &generationBuffers[generation][block * blockSize];
+    }
+
+    writeAt(data, length, offset);
+    return true;
+
+}
+
+void BlockyCoderFile::setSyncMode(SyncMode _syncMode, size_t _syncInterval)
+{
+
+    if (syncTimer) {
+        int error = syncTimer->error;
+        delete syncTimer;
+        syncTimer = NULL;
+        if (error) {
+            throw system_error(error, system_category());
+        }
+    }
+
+    syncMode = _syncMode;
+    syncInterval = max(_syncInterval, (size_t) 1);
+    if (syncMode == SYNC_GROUP) {
+        syncTimer = new SyncTimer(fd, syncInterval, asyncIO);
+    }
+
+}
+
+bool BlockyCoderFile::sync()
+{
+
+    if (asyncIO) {
+        std::lock_guard<std::mutex> lock(asyncIO->mutex);
+        drainIO();
+        throwIOError();
     }
 
-    if (fsync(fd)) {
+    if (syncTimer && syncTimer->error) {
+        throw system_error(syncTimer->error, system_category());
+    }
+
+    unsynced = 0;
+    if (syncTimer) {
+        syncTimer->dirty = false;
+    }
+
+    if (fdatasync(fd)) {
         throw system_error(errno, system_category());
     }
 
@@ -103,6 +480,207 @@ bool BlockyCoderFile::flushGeneration(size_t generation)
 
 }
 
+void BlockyCoderFile::syncFlushed()
+{
+
+    switch (syncMode) {
+
+    case SYNC_EVERY:
+
+        // Concurrent flushes may both sync, which is harmless
+        if (++unsynced >= syncInterval) {
+            unsynced = 0;
+            if (asyncIO) {
+                drainIO();
+            }
+            if (fdatasync(fd)) {
+                throw system_error(errno, system_category());
+            }
+        }
+        break;
+
+    case SYNC_GROUP:
+        if (syncTimer->error) {
+            throw system_error(syncTimer->error, system_category());
+        }
+        syncTimer->dirty = true;
+        break;
+
+    case SYNC_ON_CLOSE:
+        unsynced++;
+        break;
+
+    case NO_SYNC:
+        break;
+    }
+
+}
+
+void BlockyCoderFile::syncOnClose()
+{
+
+    if (syncTimer) {
+        delete syncTimer;
+        syncTimer = NULL;
+    }
+
+    if (syncMode != NO_SYNC && unsynced > 0 && fd >= 0) {
+        fdatasync(fd);
+        unsynced = 0;
+    }
+
+}
+
+bool BlockyCoderFile::setAsyncIO(bool enabled)
+{
+
+    if (!enabled) {
+        if (asyncIO) {
+            {
+                std::lock_guard<std::mutex> lock(asyncIO->mutex);
+                drainIO();
+            }
+            if (syncTimer) {
+                syncTimer->watch(NULL);
+            }
+            int error = asyncIO->error;
+            delete asyncIO;
+            asyncIO = NULL;
+            if (error) {
+                throw system_error(error, system_category());
+            }
+        }
+        return true;
+    }
+
+    if (asyncIO) {
+        return true;
+    }
+
+    if (fd < 0 || !IoUring::isSupported()) {
+        return false;
+    }
+
+    // An encoder reads ahead at most a window, a decoder keeps a bounded number of writes in flight
+    unsigned entries = windowSize > 0 ? (unsigned) min(windowSize, ASYNC_DEPTH) : (unsigned) ASYNC_DEPTH;
+    asyncIO = new AsyncIO(entries, windowSize);
+    if (!asyncIO->ring.getAvailable()) {
+        delete asyncIO;
+        asyncIO = NULL;
+        return false;
+    }
+
+    // Only the window stays put for the coder's lifetime; registering is an optimization, so failure is harmless
+    if (windowSize > 0) {
+        asyncIO->ring.registerBuffer(buffer, windowSize * blocksPerGeneration * blockSize);
+    }
+
+    if (syncTimer) {
+        syncTimer->watch(asyncIO);
+    }
+
+    return true;
+
+}
+
+void BlockyCoderFile::completeIO(uint64_t tag, int result)
+{
+
+    size_t generationSize = blocksPerGeneration * blockSize;
+    if (tag & READ_TAG) {
+
+        size_t slot = (size_t) (tag & ~READ_TAG);
+        size_t offset = slotGenerations[slot] * generationSize;
+        asyncIO->slotPending[slot] = false;
+
+        // A failed read ahead leaves the slot empty, and the generation is read again when needed
+        if (result < 0 || (size_t) result != min(generationSize, dataLength - offset)) {
+            slotGenerations[slot] = numGenerations;
+            slotTimes[slot] = 0;
+        }
+        return;
+    }
+
+    size_t generation = (size_t) tag;
+    size_t offset = generation * generationSize;
+    size_t length = min(coders[generation].getNumBlocks() * blockSize, dataLength - offset);
+    const uint8_t *data = generationBuffers ? generationBuffers[generation] : &buffer[offset];
+
+    // A kernel that refuses the write asynchronously has it redone here
+    if (result == -EINVAL || result == -EOPNOTSUPP) {
+        result = 0;
+    }
+
+    if (result < 0) {
+        if (!asyncIO->error) {
+            asyncIO->error = -result;
+        }
+    } else if ((size_t) result < length) {
+        try {
+            writeAt(data + result, length - result, offset + result);
+        } catch (system_error& e) {
+            if (!asyncIO->error) {
+                asyncIO->error = e.code().value();
+            }
+        }
+    }
+
+    if (generationBuffers) {
+        delete [] generationBuffers[generation];
+        generationBuffers[generation] = NULL;
+    }
+
+    // The background sync only covers writes that have finished
+    if (syncTimer) {
+        syncTimer->dirty = true;
+    }
+
+}
+
+void BlockyCoderFile::pollIO()
+{
+
+    uint64_t tag;
+    int result;
+    while (asyncIO->ring.poll(tag, result)) {
+        completeIO(tag, result);
+    }
+
+}
+
+bool BlockyCoderFile::waitIO()
+{
+
+    uint64_t tag;
+    int result;
+    if (!asyncIO->ring.wait(tag, result)) {
+        return false;
+    }
+
+    completeIO(tag, result);
+    return true;
+
+}
+
+void BlockyCoderFile::drainIO()
+{
+
+    while (waitIO()) {
+    }
+
+}
+
+void BlockyCoderFile::throwIOError()
+{
+
+    if (asyncIO->error) {
+        int error = asyncIO->error;
+        asyncIO->error = 0;
+        throw system_error(error, system_category());
+    }
+
+}
+
 BlockyCoderFile BlockyCoderFile::createEncoder(size_t _blockSize, size_t _blocksPerGeneration, string _filePath)
 {
 
@@ -131,6 +709,246 @@ BlockyCoderFile BlockyCoderFile::createEncoder(size_t _blockSize, size_t _blocks
 
 }
 
+BlockyCoderFile BlockyCoderFile::createStreamingEncoder(size_t _blockSize, size_t _blocksPerGeneration, string _filePath, size_t _windowSize)
+{
+
+    FILE *file = fopen(_filePath.c_str(), "rb");
+    if (!file) {
+        throw system_error(errno, system_category());
+    }
+
+    if (fseek(file, 0L, SEEK_END)) {
+        throw system_error(errno, system_category());
+    }
+    size_t _dataLength = ftell(file);
+    rewind(file);
+
+    size_t _numGenerations = (((_dataLength + _blockSize - 1) / _blockSize) + _blocksPerGeneration - 1) / _blocksPerGeneration;
+    BlockyCoderFile encoder(_blockSize, _blocksPerGeneration, _dataLength, _filePath, WINDOWED, min(_windowSize, _numGenerations));
+    encoder.file = file;
+    encoder.fd = fileno(file);
+
+    // Every coder starts out over the first slot and is moved to its own when loaded
+    encoder.coders = new Coder[encoder.numGenerations];
+    for (size_t i = 0; i < encoder.numGenerations; i++) {
+        size_t count = min(encoder.blocksPerGeneration, encoder.numBlocks - (i * encoder.blocksPerGeneration));
+        encoder.coders[i] = Coder::createEncoder(encoder.blockSize, count, encoder.window);
+    }
+
+    encoder.loadGeneration(0);
+    return encoder;
+
+}
+
+bool BlockyCoderFile::loadGeneration(size_t generation)
+{
+
+    if (generationBuffers) {
+        return generation < numGenerations && generationBuffers[generation] != NULL;
+    }
+
+    if (windowSize == 0) {
+        return true;
+    }
+
+    if (generation >= numGenerations) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock;
+    if (asyncIO) {
+        lock = std::unique_lock<std::mutex>(asyncIO->mutex);
+        pollIO();
+    }
+
+    windowClock++;
+    size_t slot = windowSize;
+    for (size_t i = 0; i < windowSize; i++) {
+        if (slotGenerations[i] == generation) {
+            slot = i;
+            break;
+        }
+    }
+
+    // Read ahead but not in yet
+    if (slot < windowSize && asyncIO && asyncIO->slotPending[slot]) {
+        while (asyncIO->slotPending[slot] && waitIO()) {
+        }
+
+        if (slotGenerations[slot] != generation) {
+            slot = windowSize;
+        }
+    }
+
+    bool loaded = slot == windowSize;
+    if (loaded) {
+
+        while ((slot = leastRecentSlot(0, 0)) == windowSize && waitIO()) {
+        }
+
+        if (slot == windowSize) {
+            return false;
+        }
+
+        size_t generationSize = blocksPerGeneration * blockSize;
+        size_t offset = generation * generationSize;
+        size_t length = min(generationSize, dataLength - offset);
+        uint8_t *data = &buffer[slot * generationSize];
+
+        // Until the read succeeds, the slot holds nothing
+        slotGenerations[slot] = numGenerations;
+        slotTimes[slot] = 0;
+        readAt(data, length, offset);
+        memset(data + length, 0, generationSize - length);
+
+        slotGenerations[slot] = generation;
+        coders[generation].setBlocks(&window[slot * blocksPerGeneration]);
+    }
+    slotTimes[slot] = windowClock;
+
+    if (asyncIO) {
+        if (asyncIO->aheadOf != generation) {
+            readAhead(generation);
+        }
+    } else if (loaded && generation + 1 < numGenerations) {
+        // Only a hint, so failure is harmless
+        size_t generationSize = blocksPerGeneration * blockSize;
+        posix_fadvise(fd, (generation + 1) * generationSize, windowSize * generationSize, POSIX_FADV_WILLNEED);
+    }
+
+    return true;
+
+}
+
+size_t BlockyCoderFile::leastRecentSlot(size_t first, size_t last)
+{
+
+    size_t slot = windowSize;
+    for (size_t i = 0; i < windowSize; i++) {
+        if ((asyncIO && asyncIO->slotPending[i]) || (slotGenerations[i] >= first && slotGenerations[i] < last)) {
+            continue;
+        }
+
+        if (slot == windowSize || slotTimes[i] < slotTimes[slot]) {
+            slot = i;
+        }
+    }
+    return slot;
+
+}
+
+void BlockyCoderFile::readAhead(size_t generation)
+{
+
+    asyncIO->aheadOf = generation;
+    size_t generationSize = blocksPerGeneration * blockSize;
+    size_t last = min(generation + windowSize, numGenerations);
+    for (size_t next = generation + 1; next < last; next++) {
+
+        if (getGenerationResident(next)) {
+            continue;
+        }
+
+        // Slots holding the generations up to the last one read ahead are kept
+        size_t slot = leastRecentSlot(generation, last);
+        if (slot == windowSize) {
+            return;
+        }
+
+        size_t offset = next * generationSize;
+        size_t length = min(generationSize, dataLength - offset);
+        uint8_t *data = &buffer[slot * generationSize];
+        if (!asyncIO->ring.submitRead(fd, data, length, offset, READ_TAG | slot)) {
+            return;
+        }
+
+        memset(data + length, 0, generationSize - length);
+        slotGenerations[slot] = next;
+        slotTimes[slot] = windowClock;
+        asyncIO->slotPending[slot] = true;
+        coders[next].setBlocks(&window[slot * blocksPerGeneration]);
+    }
+
+}
+
+void BlockyCoderFile::allocateGeneration(size_t generation)
+{
+
+    size_t count = coders[generation].getNumBlocks();
+    if (generationBuffers == NULL) {
+        memset(&buffer[generation * blocksPerGeneration * blockSize], 0, count * blockSize);
+        return;
+    }
+
+    if (generationBuffers[generation] != NULL) {
+        return;
+    }
+
+    generationBuffers[generation] = new uint8_t[count * blockSize];
+    memset(generationBuffers[generation], 0, count * blockSize);
+    for (size_t i = 0; i < count; i++) {
+        blocks[(generation * blocksPerGeneration) + i] = &generationBuffers[generation][i * blockSize];
+    }
+    coders[generation].setBlocks(&blocks[generation * blocksPerGeneration]);
+
+}
+
+bool BlockyCoderFile::getGenerationResident(size_t generation)
+{
+
+    if (generationBuffers) {
+        return generationBuffers[generation] != NULL;
+    }
+
+    for (size_t i = 0; i < windowSize; i++) {
+        if (slotGenerations[i] == generation) {
+            return true;
+        }
+    }
+    return windowSize == 0;
+
+}
+
+void BlockyCoderFile::readAt(uint8_t *data, size_t length, size_t offset)
+{
+
+    while (length > 0) {
+        ssize_t count = pread(fd, data, length, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            throw system_error(count < 0 ? errno : EIO, system_category());
+        }
+
+        data += count;
+        length -= count;
+        offset += count;
+    }
+
+}
+
+void BlockyCoderFile::writeAt(const uint8_t *data, size_t length, size_t offset)
+{
+
+    while (length > 0) {
+        ssize_t count = pwrite(fd, data, length, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count < 0) {
+            throw system_error(errno, system_category());
+        }
+
+        data += count;
+        length -= count;
+        offset += count;
+    }
+
+}
+
 BlockyCoderFile BlockyCoderFile::createDecoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength, string _filePath)
 {
 
@@ -155,7 +973,35 @@ BlockyCoderFile BlockyCoderFile::createDecoder(size_t _blockSize, size_t _blocks
     BlockyCoderFile decoder(_blockSize, _blocksPerGeneration, _dataLength, _filePath);
     decoder.file = file;
     decoder.fd = fileno(file);
-    memset(decoder.buffer, 0, decoder.bufferSize);
+    decoder.createDecoders();
+    return decoder;
+
+}
+
+BlockyCoderFile BlockyCoderFile::createStreamingDecoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength, string _filePath)
+{
+
+    FILE *file = fopen(_filePath.c_str(), "w+b");
+    if (!file) {
+        throw system_error(errno, system_category());
+    }
+
+    char c = 0;
+    if (fseek(file, _dataLength - 1, SEEK_SET)) {
+        throw system_error(errno, system_category());
+    }
+
+    if (1 != fwrite(&c, sizeof(char), 1, file)) {
+        throw system_error(errno, system_category());
+    }
+
+    if (fflush(file)) {
+        throw system_error(errno, system_category());
+    }
+
+    BlockyCoderFile decoder(_blockSize, _blocksPerGeneration, _dataLength, _filePath, ON_ARRIVAL);
+    decoder.file = file;
+    decoder.fd = fileno(file);
     decoder.createDecoders();
     return decoder;
 
@@ -36,6 +36,8 @@ BlockyCoderMemory::BlockyCoderMemory(BlockyCoderMemory&& other)
 BlockyCoderMemory::~BlockyCoderMemory()
 {
 
+    stopPipeline();
+
     if (buffer) {
         delete [] buffer;
     }
@@ -79,8 +81,14 @@ BlockyCoderMemory BlockyCoderMemory::createDecoder(size_t _blockSize, size_t _bl
 {
 
     BlockyCoderMemory decoder(_blockSize, _blocksPerGeneration, _dataLength);
-    memset(decoder.buffer, 0, decoder.bufferSize);
     decoder.createDecoders();
     return decoder;
 
 }
+
+void BlockyCoderMemory::allocateGeneration(size_t generation)
+{
+
+    memset(&buffer[generation * blocksPerGeneration * blockSize], 0, coders[generation].getNumBlocks() * blockSize);
+
+}
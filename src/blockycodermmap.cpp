@@ -42,6 +42,8 @@ BlockyCoderMmap::BlockyCoderMmap(BlockyCoderMmap&& other)
 BlockyCoderMmap::~BlockyCoderMmap()
 {
 
+    stopPipeline();
+
     if (file) {
         fclose(file);
         file = NULL;
@@ -183,3 +185,31 @@ bool BlockyCoderMmap::flushGeneration(size_t generation)
     return true;
 
 }
+
+bool BlockyCoderMmap::flushBlock(size_t generation, size_t block)
+{
+
+    if (!coders[generation].isBlockDecoded(block)) {
+        return false;
+    }
+
+    size_t index = (generation * blocksPerGeneration) + block;
+    size_t offset = index * blockSize;
+    size_t length = blockSize;
+
+    if (partialLastBlock && index == (numBlocks - 1)) {
+        length = dataLength % blockSize;
+        memcpy(&buffer[offset], blocks[index], length);
+    }
+
+    size_t delta = offset % pageSize;
+    offset -= delta;
+    length += delta;
+
+    if (msync(&buffer[offset], length, MS_ASYNC)) {
+        throw system_error(errno, system_category());
+    }
+
+    return true;
+
+}
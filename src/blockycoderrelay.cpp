@@ -0,0 +1,70 @@
+/*!
+    @file
+    @brief BlockyCoderRelay
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#include "blockycoderrelay.h"
+
+using namespace blocky;
+
+BlockyCoderRelay::BlockyCoderRelay() :
+    BlockyCoder()
+{
+
+}
+
+BlockyCoderRelay::BlockyCoderRelay(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength) :
+    BlockyCoder(_blockSize, _blocksPerGeneration, _dataLength)
+{
+
+}
+
+BlockyCoderRelay::BlockyCoderRelay(BlockyCoderRelay&& other)
+    : BlockyCoderRelay()
+{
+
+    swap(*this, other);
+
+}
+
+BlockyCoderRelay::~BlockyCoderRelay()
+{
+
+    stopPipeline();
+
+}
+
+BlockyCoderRelay& BlockyCoderRelay::operator =(BlockyCoderRelay& other)
+{
+
+    swap(*this, other);
+    return *this;
+
+}
+
+BlockyCoderRelay& BlockyCoderRelay::operator =(BlockyCoderRelay&& other)
+{
+
+    swap(*this, other);
+    return *this;
+
+}
+
+void BlockyCoderRelay::swap(BlockyCoderRelay& first, BlockyCoderRelay& second)
+{
+
+    BlockyCoder::swap(first, second);
+
+}
+
+BlockyCoderRelay BlockyCoderRelay::createRelay(size_t _blockSize, size_t _blocksPerGeneration, size_t _dataLength)
+{
+
+    BlockyCoderRelay relay(_blockSize, _blocksPerGeneration, _dataLength);
+    relay.createRecoders();
+    return relay;
+
+}
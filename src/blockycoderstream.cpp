@@ -0,0 +1,335 @@
+/*!
+    @file
+    @brief BlockyCoderStream
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#include <algorithm>
+#include "blockycoderstream.h"
+
+using namespace blocky;
+
+const size_t BlockyCoderStream::NO_GENERATION;
+const size_t BlockyCoderStream::LENGTH_SIZE;
+
+BlockyCoderStream::BlockyCoderStream() :
+    blockSize(0),
+    blocksPerGeneration(0),
+    windowSize(0),
+    numSlots(0),
+    encoding(false),
+    seeded(false),
+    systematic(false),
+    mode(Coder::ECHELON),
+    firstGeneration(0),
+    nextGeneration(0),
+    fill(0),
+    buffer(NULL),
+    blocks(NULL),
+    coders(NULL),
+    slotGenerations(NULL)
+{
+
+}
+
+BlockyCoderStream::BlockyCoderStream(size_t _blockSize, size_t _blocksPerGeneration, size_t _windowSize, size_t _numSlots) :
+    blockSize(_blockSize),
+    blocksPerGeneration(_blocksPerGeneration),
+    windowSize(_windowSize),
+    numSlots(_numSlots),
+    encoding(false),
+    seeded(false),
+    systematic(false),
+    mode(Coder::ECHELON),
+    firstGeneration(0),
+    nextGeneration(0),
+    fill(0),
+    buffer(NULL),
+    blocks(NULL),
+    coders(NULL),
+    slotGenerations(NULL)
+{
+
+    buffer = new uint8_t[numSlots * blocksPerGeneration * blockSize];
+    memset(buffer, 0, numSlots * blocksPerGeneration * blockSize);
+
+    blocks = new uint8_t*[numSlots * blocksPerGeneration];
+    for (size_t i = 0; i < numSlots * blocksPerGeneration; i++) {
+        blocks[i] = &buffer[i * blockSize];
+    }
+
+    coders = new Coder[numSlots];
+    slotGenerations = new size_t[numSlots];
+    for (size_t i = 0; i < numSlots; i++) {
+        slotGenerations[i] = NO_GENERATION;
+    }
+
+}
+
+BlockyCoderStream::BlockyCoderStream(BlockyCoderStream&& other)
+    : BlockyCoderStream()
+{
+
+    swap(*this, other);
+
+}
+
+BlockyCoderStream::~BlockyCoderStream()
+{
+
+    if (buffer) {
+        delete [] buffer;
+    }
+
+    if (blocks) {
+        delete [] blocks;
+    }
+
+    if (coders) {
+        delete [] coders;
+    }
+
+    if (slotGenerations) {
+        delete [] slotGenerations;
+    }
+
+}
+
+BlockyCoderStream& BlockyCoderStream::operator =(BlockyCoderStream& other)
+{
+
+    swap(*this, other);
+    return *this;
+
+}
+
+BlockyCoderStream& BlockyCoderStream::operator =(BlockyCoderStream&& other)
+{
+
+    swap(*this, other);
+    return *this;
+
+}
+
+void BlockyCoderStream::swap(BlockyCoderStream& first, BlockyCoderStream& second)
+{
+
+    using std::swap;
+    swap(first.blockSize, second.blockSize);
+    swap(first.blocksPerGeneration, second.blocksPerGeneration);
+    swap(first.windowSize, second.windowSize);
+    swap(first.numSlots, second.numSlots);
+    swap(first.encoding, second.encoding);
+    swap(first.seeded, second.seeded);
+    swap(first.systematic, second.systematic);
+    swap(first.mode, second.mode);
+    swap(first.firstGeneration, second.firstGeneration);
+    swap(first.nextGeneration, second.nextGeneration);
+    swap(first.fill, second.fill);
+    swap(first.buffer, second.buffer);
+    swap(first.blocks, second.blocks);
+    swap(first.coders, second.coders);
+    swap(first.slotGenerations, second.slotGenerations);
+
+}
+
+BlockyCoderStream BlockyCoderStream::createEncoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _windowSize)
+{
+
+    BlockyCoderStream encoder(_blockSize, _blocksPerGeneration, _windowSize, _windowSize + 1);
+    encoder.encoding = true;
+    return encoder;
+
+}
+
+BlockyCoderStream BlockyCoderStream::createDecoder(size_t _blockSize, size_t _blocksPerGeneration, size_t _windowSize)
+{
+
+    return BlockyCoderStream(_blockSize, _blocksPerGeneration, _windowSize, _windowSize);
+
+}
+
+size_t BlockyCoderStream::append(const uint8_t *data, size_t length)
+{
+
+    if (!encoding) {
+        return 0;
+    }
+
+    size_t generationSize = blocksPerGeneration * blockSize;
+    size_t capacity = getGenerationCapacity();
+    size_t sealed = 0;
+    while (length > 0) {
+
+        size_t count = std::min(length, capacity - fill);
+        memcpy(&buffer[(getSlot(nextGeneration) * generationSize) + fill], data, count);
+        fill += count;
+        data += count;
+        length -= count;
+
+        if (fill == capacity) {
+            seal();
+            sealed++;
+        }
+    }
+
+    return sealed;
+
+}
+
+bool BlockyCoderStream::seal()
+{
+
+    if (!encoding || fill == 0) {
+        return false;
+    }
+
+    size_t generationSize = blocksPerGeneration * blockSize;
+    size_t slot = getSlot(nextGeneration);
+    size_t count = (fill + LENGTH_SIZE + blockSize - 1) / blockSize;
+    uint8_t *data = &buffer[slot * generationSize];
+    memset(&data[fill], 0, (count * blockSize) - fill);
+
+    // The length goes in the last bytes of the last block, so the decoder finds it from numBlocks
+    uint8_t *end = &data[(count * blockSize) - LENGTH_SIZE];
+    for (size_t i = 0; i < LENGTH_SIZE; i++) {
+        end[i] = (uint8_t) (fill >> (8 * i));
+    }
+
+    coders[slot] = Coder::createEncoder(blockSize, count, &blocks[slot * blocksPerGeneration]);
+    coders[slot].setSystematic(systematic);
+    slotGenerations[slot] = nextGeneration;
+
+    // The slot of the oldest sealed generation is filled next
+    nextGeneration++;
+    fill = 0;
+    if (nextGeneration > windowSize) {
+        firstGeneration = nextGeneration - windowSize;
+    }
+
+    return true;
+
+}
+
+bool BlockyCoderStream::encode(BlockyPacket& packet, size_t generation)
+{
+
+    if (!encoding || generation < firstGeneration || generation >= nextGeneration) {
+        return false;
+    }
+
+    Coder& coder = coders[getSlot(generation)];
+    packet.generation = generation;
+    packet.numBlocks = coder.getNumBlocks();
+    packet.blockSize = blockSize;
+
+    if (packet.data == NULL) {
+        packet.data = new uint8_t[packet.blockSize];
+    }
+
+    packet.seeded = seeded && coder.encodeSeeded(packet.data, packet.seed);
+    if (packet.seeded) {
+        return true;
+    }
+
+    // Generations sealed early are shorter, so the array must fit the longest
+    if (packet.coeffs == NULL) {
+        packet.coeffs = new uint8_t[blocksPerGeneration];
+    }
+
+    return coder.encode(packet.data, packet.coeffs);
+
+}
+
+bool BlockyCoderStream::store(BlockyPacket& packet)
+{
+
+    if (encoding || packet.blockSize != blockSize || packet.numBlocks * blockSize < LENGTH_SIZE || packet.numBlocks > blocksPerGeneration) {
+        return false;
+    }
+
+    size_t generation = packet.generation;
+    if (generation < firstGeneration || generation - firstGeneration >= windowSize) {
+        return false;
+    }
+
+    // Seen for the first time; the slot's previous generation has been delivered or skipped
+    size_t slot = getSlot(generation);
+    if (slotGenerations[slot] != generation) {
+        coders[slot] = Coder::createDecoder(blockSize, packet.numBlocks, &blocks[slot * blocksPerGeneration]);
+        coders[slot].setDecodingMode(mode);
+        slotGenerations[slot] = generation;
+    }
+
+    Coder& coder = coders[slot];
+    if (packet.numBlocks != coder.getNumBlocks()) {
+        return false;
+    }
+
+    if (packet.seeded) {
+        return coder.storeSeeded(packet.data, packet.seed);
+    }
+
+    return coder.store(packet.data, packet.coeffs);
+
+}
+
+const uint8_t *BlockyCoderStream::deliver(size_t& length)
+{
+
+    if (encoding) {
+        return NULL;
+    }
+
+    size_t slot = getSlot(firstGeneration);
+    if (slotGenerations[slot] != firstGeneration || !coders[slot].decode()) {
+        return NULL;
+    }
+
+    uint8_t *data = &buffer[slot * blocksPerGeneration * blockSize];
+    size_t available = (coders[slot].getNumBlocks() * blockSize) - LENGTH_SIZE;
+    const uint8_t *end = &data[available];
+    length = 0;
+    for (size_t i = 0; i < LENGTH_SIZE; i++) {
+        length |= (size_t) end[i] << (8 * i);
+    }
+
+    // A corrupt length must not reach past the generation
+    length = std::min(length, available);
+    slotGenerations[slot] = NO_GENERATION;
+    firstGeneration++;
+    return data;
+
+}
+
+bool BlockyCoderStream::skipTo(size_t generation)
+{
+
+    if (encoding || generation < firstGeneration) {
+        return false;
+    }
+
+    for (size_t i = 0; i < numSlots; i++) {
+        if (slotGenerations[i] != NO_GENERATION && slotGenerations[i] < generation) {
+            slotGenerations[i] = NO_GENERATION;
+        }
+    }
+
+    firstGeneration = generation;
+    return true;
+
+}
+
+size_t BlockyCoderStream::getRank(size_t generation)
+{
+
+    size_t slot = getSlot(generation);
+    if (slotGenerations[slot] != generation) {
+        return 0;
+    }
+
+    return coders[slot].getRank();
+
+}
@@ -13,15 +13,44 @@
 #include "blockycodermemory.h"
 #include "blockycoderfile.h"
 #include "blockycodermmap.h"
+#include "blockycoderrelay.h"
+#include "blockycoderstream.h"
+#include "ranktracker.h"
+#include "threadpool.h"
 
 #include <vector>
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include <new>
 
 using namespace std;
 using namespace blocky;
 
+// Counts every allocation in the program, for the tests of allocation free paths
+atomic<size_t> numAllocations(0);
+
+void *operator new(size_t size)
+{
+
+    numAllocations++;
+    void *p = malloc(size ? size : 1);
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
 void freeBuffers(vector<uint8_t *> buffers) 
 {
 
@@ -31,7 +60,23 @@ void freeBuffers(vector<uint8_t *> buffers)
 
 }
 
-template <typename B> bool testEndToEndBlockyCoder(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, bool verifyFileOutput = true) 
+const char *modeName(Coder::DecodingMode mode)
+{
+
+    switch (mode) {
+    case Coder::GAUSS_JORDAN:
+        return "gauss-jordan";
+    case Coder::DEFERRED:
+        return "deferred";
+    case Coder::RECODING:
+        return "recoding";
+    default:
+        return "echelon";
+    }
+
+}
+
+template <typename B> bool testEndToEndBlockyCoder(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, bool verifyFileOutput = true, Coder::DecodingMode mode = Coder::ECHELON) 
 {
 
     uint8_t *data = new uint8_t[dataLength];
@@ -55,7 +100,14 @@ template <typename B> bool testEndToEndBlockyCoder(size_t blockSize, size_t bloc
         B encoder = Utils::createBlockyEncoder<B>(blockSize, blocksPerGeneration, dataLength, "test.enc", data);
         B decoder = Utils::createBlockyDecoder<B>(blockSize, blocksPerGeneration, dataLength, "test.dec", data);
 
+        if (!decoder.setDecodingMode(mode)) {
+            printf("Can't set decoding mode!\n");
+            goto err;
+        }
+
         for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+
+            vector<bool> flushed(encoder.getNumBlocksInGeneration(i), false);
             for (size_t j = 0; j < encoder.getNumBlocksInGeneration(i); j++) {
 
                 BlockyPacket packet;
@@ -76,11 +128,27 @@ template <typename B> bool testEndToEndBlockyCoder(size_t blockSize, size_t bloc
                     goto err;
                 }
 
+                // Release blocks as soon as they are decoded
+                for (size_t k = 0; k < flushed.size(); k++) {
+                    if (!flushed[k] && decoder.getBlockDecoded(i, k)) {
+                        if (!decoder.flushBlock(i, k)) {
+                            printf("Flushing block (%lu, %lu) failed!\n", i, k);
+                            goto err;
+                        }
+                        flushed[k] = true;
+                    }
+                }
+
             }
 
             if (!decoder.canDecodeGeneration(i)) {
                 printf("Can't decode generation %lu!\n", i);
             }
+
+            if (mode == Coder::GAUSS_JORDAN && find(flushed.begin(), flushed.end(), false) != flushed.end()) {
+                printf("Generation %lu not fully released before decoding!\n", i);
+                goto err;
+            }
         }
 
         if (!decoder.canDecode()) {
@@ -143,39 +211,1861 @@ err:
     return false;
 }
 
-struct MultiTestCase {
-    size_t blockSize;
-    size_t blocksPerGeneration;
-    size_t dataLength;
-};
+bool testGF28Implementation(GF28::Implementation impl, size_t size)
+{
+
+    GF28 gf;
+    uint8_t *data = new uint8_t[size];
+    uint8_t *src = new uint8_t[size];
+    uint8_t *expected = new uint8_t[size];
+    bool retval = true;
+
+    for (size_t c = 0; c < 256 && retval; c++) {
+
+        for (size_t i = 0; i < size; i++) {
+            data[i] = rand() % 256;
+            src[i] = rand() % 256;
+        }
+
+        // Reference results, computed element by element
+        for (size_t i = 0; i < size; i++) {
+            expected[i] = gf.add(data[i], gf.mul((uint8_t) c, src[i]));
+        }
+
+        GF28::setImplementation(impl);
+        gf.addMultiple(c, data, src, size);
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] != expected[i]) {
+                printf("addMultiple(%lu): data[%lu] = %u != %u!\n", c, i, data[i], expected[i]);
+                retval = false;
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            expected[i] = gf.mul((uint8_t) c, data[i]);
+        }
+
+        gf.mul(c, data, size);
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] != expected[i]) {
+                printf("mul(%lu): data[%lu] = %u != %u!\n", c, i, data[i], expected[i]);
+                retval = false;
+                break;
+            }
+        }
+
+    }
 
-template <typename B> bool testEndToEndBlockyCoderMulti(vector<MultiTestCase> cases, const char *name, bool verifyFileOutput = true)
+    GF28::setImplementation(GF28::getBestImplementation());
+    delete [] data;
+    delete [] src;
+    delete [] expected;
+    return retval;
+}
+
+bool testGF28Implementations()
 {
 
     bool retval = true;
-    for (size_t i = 0; i < cases.size(); i++) {
-        bool success = testEndToEndBlockyCoder<B>(cases[i].blockSize, cases[i].blocksPerGeneration, cases[i].dataLength, verifyFileOutput);
-        printf("%s(%lu, %lu, %lu): %s\n", name, cases[i].blockSize, cases[i].blocksPerGeneration, cases[i].dataLength, success ? "true" : "false");
+    const size_t sizes[] = {1, 15, 64, 131, 4099};
+    for (int i = 0; i < GF28::NUM_IMPLEMENTATIONS; i++) {
+
+        GF28::Implementation impl = (GF28::Implementation) i;
+        if (!GF28::isSupported(impl)) {
+            printf("testGF28Implementation(%s): skipped\n", GF28::getImplementationName(impl));
+            continue;
+        }
+
+        bool success = true;
+        for (size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++) {
+            success &= testGF28Implementation(impl, sizes[j]);
+        }
+        printf("testGF28Implementation(%s): %s\n", GF28::getImplementationName(impl), success ? "true" : "false");
         retval &= success;
     }
     return retval;
 }
 
-int main() {
+bool testGF28LinearCombination(size_t n, size_t size)
+{
 
-    srand(15);
+    GF28 gf;
+    uint8_t *data = new uint8_t[size];
+    uint8_t *expected = new uint8_t[size];
+    uint8_t *c = new uint8_t[n];
+    uint8_t **sources = new uint8_t*[n];
+    bool retval = true;
 
-    vector<MultiTestCase> cases = {
-        {1, 4, 39},
-        {2048, 4, 43151},
-        {32, 16, 65537},
-        {32768, 16, 4*1048576}
+    memset(expected, 0, size);
+    for (size_t i = 0; i < n; i++) {
+        c[i] = (i % 3 == 0) ? 0 : rand() % 256;
+        sources[i] = new uint8_t[size];
+        for (size_t j = 0; j < size; j++) {
+            sources[i][j] = rand() % 256;
+            expected[j] = gf.add(expected[j], gf.mul(c[i], sources[i][j]));
+        }
+    }
+
+    memset(data, 0xff, size);
+    gf.linearCombination(data, c, sources, n, size);
+    if (memcmp(data, expected, size) != 0) {
+        printf("linearCombination(%lu, %lu) mismatch!\n", n, size);
+        retval = false;
+    }
+
+    gf.addMultiples(data, c, sources, n, size);
+    for (size_t j = 0; j < size; j++) {
+        if (data[j] != 0) {
+            printf("addMultiples(%lu, %lu): data[%lu] = %u != 0!\n", n, size, j, data[j]);
+            retval = false;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        delete [] sources[i];
+    }
+    delete [] sources;
+    delete [] c;
+    delete [] expected;
+    delete [] data;
+
+    printf("testGF28LinearCombination(%lu, %lu): %s\n", n, size, retval ? "true" : "false");
+    return retval;
+}
+
+bool testGF28MatrixProduct(size_t m, size_t n, size_t size)
+{
+
+    GF28 gf;
+    uint8_t **outputs = new uint8_t*[m];
+    uint8_t **c = new uint8_t*[m];
+    uint8_t **sources = new uint8_t*[n];
+    uint8_t *expected = new uint8_t[size];
+    bool retval = true;
+
+    for (size_t i = 0; i < n; i++) {
+        sources[i] = new uint8_t[size];
+        for (size_t k = 0; k < size; k++) {
+            sources[i][k] = rand() % 256;
+        }
+    }
+
+    for (size_t j = 0; j < m; j++) {
+        outputs[j] = new uint8_t[size];
+        c[j] = new uint8_t[n];
+        for (size_t i = 0; i < n; i++) {
+            c[j][i] = ((i + j) % 5 == 0) ? 0 : rand() % 256;
+        }
+    }
+
+    for (int impl = 0; impl < GF28::NUM_IMPLEMENTATIONS; impl++) {
+
+        if (!GF28::setImplementation((GF28::Implementation) impl)) {
+            continue;
+        }
+
+        for (size_t j = 0; j < m; j++) {
+            memset(outputs[j], 0xff, size);
+        }
+        gf.matrixProduct(outputs, c, m, sources, n, size);
+
+        for (size_t j = 0; j < m; j++) {
+            gf.linearCombination(expected, c[j], sources, n, size);
+            if (memcmp(outputs[j], expected, size) != 0) {
+                printf("matrixProduct(%s): output %lu mismatch!\n", GF28::getImplementationName((GF28::Implementation) impl), j);
+                retval = false;
+            }
+        }
+    }
+
+    GF28::setImplementation(GF28::getBestImplementation());
+    for (size_t i = 0; i < n; i++) {
+        delete [] sources[i];
+    }
+    for (size_t j = 0; j < m; j++) {
+        delete [] outputs[j];
+        delete [] c[j];
+    }
+    delete [] sources;
+    delete [] outputs;
+    delete [] c;
+    delete [] expected;
+
+    printf("testGF28MatrixProduct(%lu, %lu, %lu): %s\n", m, n, size, retval ? "true" : "false");
+    return retval;
+}
+
+bool testGF28Striping(size_t numThreads, size_t n, size_t size)
+{
+
+    ThreadPool pool(numThreads);
+    GF28 gf, striped;
+    striped.setThreadPool(&pool);
+
+    uint8_t **c = new uint8_t*[n];
+    uint8_t **sources = new uint8_t*[n];
+    uint8_t **outputs = new uint8_t*[n];
+    uint8_t **expected = new uint8_t*[n];
+    bool retval = true;
+
+    for (size_t i = 0; i < n; i++) {
+        c[i] = new uint8_t[n];
+        sources[i] = new uint8_t[size];
+        outputs[i] = new uint8_t[size];
+        expected[i] = new uint8_t[size];
+        for (size_t k = 0; k < n; k++) {
+            c[i][k] = rand() % 256;
+        }
+        for (size_t k = 0; k < size; k++) {
+            sources[i][k] = rand() % 256;
+        }
+    }
+
+    gf.linearCombination(expected[0], c[0], sources, n, size);
+    striped.linearCombination(outputs[0], c[0], sources, n, size);
+    if (memcmp(outputs[0], expected[0], size) != 0) {
+        printf("linearCombination mismatch!\n");
+        retval = false;
+    }
+
+    gf.addMultiples(expected[0], c[1], sources, n, size);
+    striped.addMultiples(outputs[0], c[1], sources, n, size);
+    if (memcmp(outputs[0], expected[0], size) != 0) {
+        printf("addMultiples mismatch!\n");
+        retval = false;
+    }
+
+    gf.matrixProduct(expected, c, n, sources, n, size);
+    striped.matrixProduct(outputs, c, n, sources, n, size);
+    for (size_t j = 0; j < n; j++) {
+        if (memcmp(outputs[j], expected[j], size) != 0) {
+            printf("matrixProduct mismatch!\n");
+            retval = false;
+            break;
+        }
+    }
+
+    // In place, so both sides start from the product above
+    gf.transform(expected, c, n, size);
+    striped.transform(outputs, c, n, size);
+    for (size_t j = 0; j < n; j++) {
+        if (memcmp(outputs[j], expected[j], size) != 0) {
+            printf("transform mismatch!\n");
+            retval = false;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        delete [] c[i];
+        delete [] sources[i];
+        delete [] outputs[i];
+        delete [] expected[i];
+    }
+    delete [] c;
+    delete [] sources;
+    delete [] outputs;
+    delete [] expected;
+
+    printf("testGF28Striping(%lu, %lu, %lu): %s\n", numThreads, n, size, retval ? "true" : "false");
+    return retval;
+}
+
+bool testCoderPivoting()
+{
+
+    const size_t blockSize = 8;
+    const size_t numBlocks = 4;
+    GF28 gf;
+
+    uint8_t original[numBlocks][blockSize];
+    uint8_t decoded[numBlocks][blockSize];
+    uint8_t *blocks[numBlocks];
+    for (size_t i = 0; i < numBlocks; i++) {
+        for (size_t j = 0; j < blockSize; j++) {
+            original[i][j] = rand() % 256;
+        }
+        blocks[i] = decoded[i];
+    }
+
+    // Coefficient vectors, and whether each one is innovative when stored in this order
+    const uint8_t vectors[][numBlocks] = {
+        {0, 0, 0, 7},
+        {0, 3, 0, 0},
+        {0, 6, 0, 14},
+        {5, 0, 9, 0},
+        {0, 0, 0, 1},
+        {0, 0, 2, 0},
     };
-    bool success = true;
+    const bool innovative[] = {true, true, false, true, false, true};
 
-    success &= testEndToEndBlockyCoderMulti<BlockyCoderMemory>(cases, "testEndToEndBlockyCoderMemory", false);
-    success &= testEndToEndBlockyCoderMulti<BlockyCoderFile>(cases, "testEndToEndBlockyCoderFile");
-    success &= testEndToEndBlockyCoderMulti<BlockyCoderMmap>(cases, "testEndToEndBlockyCoderMmap");
+    Coder decoder = Coder::createDecoder(blockSize, numBlocks, blocks);
+    for (size_t i = 0; i < sizeof(innovative) / sizeof(innovative[0]); i++) {
+
+        uint8_t coeffs[numBlocks];
+        uint8_t block[blockSize];
+        memset(block, 0, blockSize);
+        for (size_t k = 0; k < numBlocks; k++) {
+            coeffs[k] = vectors[i][k];
+            gf.addMultiple(coeffs[k], block, original[k], blockSize);
+        }
+
+        size_t rank = decoder.getRank();
+        if (decoder.store(block, coeffs) != innovative[i]) {
+            printf("store(%lu) != %s!\n", i, innovative[i] ? "true" : "false");
+            return false;
+        }
+
+        if (decoder.getRank() != rank + (innovative[i] ? 1 : 0)) {
+            printf("rank %lu after store(%lu)!\n", decoder.getRank(), i);
+            return false;
+        }
+    }
+
+    if (!decoder.decode()) {
+        printf("Decoding failed!\n");
+        return false;
+    }
+
+    return memcmp(original, decoded, sizeof(original)) == 0;
+}
+
+bool testLossyTransfer(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t dropEvery, Coder::DecodingMode mode, bool systematic, bool seeded, size_t nonzeros)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    BlockyPacket packet;
+    size_t sent = 0;
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setSystematic(systematic);
+        encoder.setSeeded(seeded);
+        encoder.setNonzeros(nonzeros);
+        decoder.setDecodingMode(mode);
+
+        for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+            while (!decoder.canDecodeGeneration(i)) {
+
+                if (!encoder.encode(packet, i)) {
+                    printf("Error encoding packet for generation %lu!\n", i);
+                    retval = false;
+                    break;
+                }
+
+                if (seeded && !systematic && nonzeros == 0 && !packet.seeded) {
+                    printf("Packet for generation %lu is not seeded!\n", i);
+                    retval = false;
+                    break;
+                }
+
+                if (sent % dropEvery != 0) {
+                    decoder.store(packet);
+                }
+                sent++;
+            }
+        }
+
+        if (retval && (!decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    delete [] packet.data;
+    delete [] packet.coeffs;
+    delete [] data;
+
+    printf("testLossyTransfer(%lu, %lu, %lu, %lu, %s%s%s, %lu): %s\n", blockSize, blocksPerGeneration, dataLength, dropEvery, modeName(mode), systematic ? ", systematic" : "", seeded ? ", seeded" : "", nonzeros, retval ? "true" : "false");
+    return retval;
+}
+
+bool testAugmentedDecoder(size_t blockSize, size_t numBlocks, Coder::DecodingMode mode)
+{
+
+    uint8_t *data = new uint8_t[blockSize * numBlocks];
+    uint8_t **blocks = new uint8_t*[numBlocks];
+    for (size_t i = 0; i < numBlocks; i++) {
+        blocks[i] = &data[i * blockSize];
+        for (size_t j = 0; j < blockSize; j++) {
+            blocks[i][j] = rand() % 256;
+        }
+    }
+
+    bool retval = true;
+    uint8_t *block = new uint8_t[blockSize];
+    uint8_t *coeffs = new uint8_t[numBlocks];
+    Coder encoder = Coder::createEncoder(blockSize, numBlocks, blocks);
+    Coder decoder = Coder::createDecoder(blockSize, numBlocks);
+    decoder.setDecodingMode(mode);
+
+    for (size_t i = 0; i < numBlocks; i++) {
+        if (((uintptr_t) decoder[i]) % Coder::RECORD_ALIGNMENT != 0) {
+            printf("Block %lu is not aligned!\n", i);
+            retval = false;
+            break;
+        }
+    }
+
+    // Store half the packets, copy the decoder and finish with the copy
+    while (retval && decoder.getRank() < numBlocks / 2) {
+        encoder.encode(block, coeffs);
+        decoder.store(block, coeffs);
+    }
+
+    Coder copy = decoder;
+    while (retval && !copy.canDecode()) {
+        encoder.encode(block, coeffs);
+        copy.store(block, coeffs);
+    }
+
+    if (retval && !copy.decode()) {
+        printf("Decoding failed!\n");
+        retval = false;
+    }
+
+    for (size_t i = 0; retval && i < numBlocks; i++) {
+        if (memcmp(copy[i], blocks[i], blockSize) != 0) {
+            printf("Block %lu mismatch!\n", i);
+            retval = false;
+        }
+    }
+
+    delete [] coeffs;
+    delete [] block;
+    delete [] blocks;
+    delete [] data;
+
+    printf("testAugmentedDecoder(%lu, %lu, %s): %s\n", blockSize, numBlocks, modeName(mode), retval ? "true" : "false");
+    return retval;
+}
+
+bool testAllocationFree(size_t blockSize, size_t numBlocks)
+{
+
+    uint8_t *data = new uint8_t[numBlocks * blockSize];
+    uint8_t **blocks = new uint8_t*[numBlocks];
+    for (size_t i = 0; i < numBlocks; i++) {
+        blocks[i] = &data[i * blockSize];
+        for (size_t j = 0; j < blockSize; j++) {
+            blocks[i][j] = rand() % 256;
+        }
+    }
+
+    bool retval = true;
+    uint8_t *block = new uint8_t[blockSize];
+    uint8_t *coeffs = new uint8_t[numBlocks];
+    for (size_t i = 0; i < numBlocks; i++) {
+        coeffs[i] = rand() % 256;
+    }
+    Coder encoder = Coder::createEncoder(blockSize, numBlocks, blocks);
+    Coder decoder = Coder::createDecoder(blockSize, numBlocks);
+
+    // Without a thread pool, region operations and the per packet path allocate nothing
+    GF28 gf;
+    size_t before = numAllocations;
+    gf.linearCombination(block, coeffs, blocks, numBlocks, blockSize);
+    if (numAllocations != before) {
+        printf("linearCombination allocated %lu times!\n", (size_t) (numAllocations - before));
+        retval = false;
+    }
+
+    before = numAllocations;
+    for (size_t i = 0; i < numBlocks + 2; i++) {
+        encoder.encode(block, coeffs);
+        decoder.store(block, coeffs);
+    }
+    if (numAllocations != before) {
+        printf("Encoding and storing allocated %lu times!\n", (size_t) (numAllocations - before));
+        retval = false;
+    }
+
+    // Recoding from a coder that hasn't decoded yet, once its scratch is in place
+    const Coder& recoder = decoder;
+    PRNG prng(1);
+    recoder.encode(block, coeffs, prng);
+    before = numAllocations;
+    for (size_t i = 0; i < numBlocks; i++) {
+        recoder.encode(block, coeffs, prng);
+    }
+    if (numAllocations != before) {
+        printf("Recoding allocated %lu times!\n", (size_t) (numAllocations - before));
+        retval = false;
+    }
+
+    if (retval && (!decoder.decode() || memcmp(decoder[numBlocks - 1], blocks[numBlocks - 1], blockSize) != 0)) {
+        printf("Decoding failed!\n");
+        retval = false;
+    }
+
+    delete [] coeffs;
+    delete [] block;
+    delete [] blocks;
+    delete [] data;
+
+    printf("testAllocationFree(%lu, %lu): %s\n", blockSize, numBlocks, retval ? "true" : "false");
+    return retval;
+}
+
+bool testEncodeBatch(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t count, bool systematic, bool seeded)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    BlockyPacket packet;
+    BlockyPacket *packets = new BlockyPacket[count];
+    size_t sent = 0;
+    {
+        BlockyCoderMemory encoder1 = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory encoder2 = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder1.setSeed(7);
+        encoder2.setSeed(7);
+        encoder1.setSystematic(systematic);
+        encoder2.setSystematic(systematic);
+        encoder1.setSeeded(seeded);
+        encoder2.setSeeded(seeded);
+
+        for (size_t i = 0; retval && i < encoder2.getNumGenerations(); i++) {
+            while (retval && !decoder.canDecodeGeneration(i)) {
+
+                if (!encoder2.encodeBatch(i, count, packets)) {
+                    printf("Error encoding batch for generation %lu!\n", i);
+                    retval = false;
+                    break;
+                }
+
+                // A batch must match the same number of single encodes
+                for (size_t j = 0; j < count; j++) {
+
+                    encoder1.encode(packet, i);
+                    if (packet.seeded != packets[j].seeded || memcmp(packet.data, packets[j].data, packet.blockSize) != 0 ||
+                        (packet.seeded ? packet.seed != packets[j].seed : memcmp(packet.coeffs, packets[j].coeffs, packet.numBlocks) != 0)) {
+                        printf("Batch packet %lu differs for generation %lu!\n", j, i);
+                        retval = false;
+                        break;
+                    }
+
+                    if (sent % 4 != 0) {
+                        decoder.store(packets[j]);
+                    }
+                    sent++;
+                }
+            }
+        }
+
+        if (retval && (!decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    for (size_t j = 0; j < count; j++) {
+        delete [] packets[j].data;
+        delete [] packets[j].coeffs;
+    }
+    delete [] packets;
+    delete [] packet.data;
+    delete [] packet.coeffs;
+    delete [] data;
+
+    printf("testEncodeBatch(%lu, %lu, %lu, %lu%s%s): %s\n", blockSize, blocksPerGeneration, dataLength, count, systematic ? ", systematic" : "", seeded ? ", seeded" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testStoreBatch(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t count, Coder::DecodingMode mode, bool systematic, bool seeded)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    BlockyPacket *packets = new BlockyPacket[count];
+    for (size_t j = 0; j < count; j++) {
+        packets[j].data = new uint8_t[blockSize];
+        packets[j].coeffs = new uint8_t[blocksPerGeneration];
+    }
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setSystematic(systematic);
+        encoder.setSeeded(seeded);
+        decoder.setDecodingMode(mode);
+
+        // Each batch mixes runs of packets from a few generations, some of them repeated
+        size_t generation = 0;
+        while (retval && !decoder.canDecode()) {
+
+            size_t rankBefore = 0;
+            for (size_t i = 0; i < decoder.getNumGenerations(); i++) {
+                rankBefore += decoder.getRank(i);
+            }
+
+            for (size_t j = 0; j < count; j++) {
+                if (j % 5 == 0) {
+                    generation = (generation + 1) % encoder.getNumGenerations();
+                }
+                if (j % 7 != 3) {
+                    encoder.encode(packets[j], generation);
+                }
+            }
+
+            size_t helpful = decoder.storeBatch(packets, count);
+
+            size_t rankAfter = 0;
+            for (size_t i = 0; i < decoder.getNumGenerations(); i++) {
+                rankAfter += decoder.getRank(i);
+            }
+
+            if (helpful != rankAfter - rankBefore) {
+                printf("%lu helpful packets but the rank rose by %lu!\n", helpful, rankAfter - rankBefore);
+                retval = false;
+            }
+        }
+
+        if (retval && (!decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    for (size_t j = 0; j < count; j++) {
+        delete [] packets[j].data;
+        delete [] packets[j].coeffs;
+    }
+    delete [] packets;
+    delete [] data;
+
+    printf("testStoreBatch(%lu, %lu, %lu, %lu, %s%s%s): %s\n", blockSize, blocksPerGeneration, dataLength, count, modeName(mode), systematic ? ", systematic" : "", seeded ? ", seeded" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testStoreOwned(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t dropEvery, Coder::DecodingMode mode, bool seeded)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    BlockyPacket packet;
+    size_t sent = 0, adopted = 0;
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setSeeded(seeded);
+        decoder.setDecodingMode(mode);
+
+        for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+            while (!decoder.canDecodeGeneration(i)) {
+
+                if (packet.data == NULL) {
+                    packet.data = Coder::allocateBlock(blockSize);
+                }
+
+                encoder.encode(packet, i);
+                if (sent++ % dropEvery == 0) {
+                    continue;
+                }
+
+                decoder.storeOwned(packet);
+                if (packet.data == NULL) {
+                    adopted++;
+                }
+            }
+        }
+
+        // Only deferred decoding keeps blocks as received
+        size_t expected = (mode == Coder::DEFERRED) ? encoder.getNumBlocks() : 0;
+        if (adopted != expected) {
+            printf("%lu blocks adopted instead of %lu!\n", adopted, expected);
+            retval = false;
+        }
+
+        if (retval && (!decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    Coder::freeBlock(packet.data);
+    delete [] packet.coeffs;
+    delete [] data;
+
+    printf("testStoreOwned(%lu, %lu, %lu, %lu, %s%s): %s\n", blockSize, blocksPerGeneration, dataLength, dropEvery, modeName(mode), seeded ? ", seeded" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testRelay(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t dropEvery, bool seeded)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    BlockyPacket in, out;
+    size_t sent = 0, adopted = 0;
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderRelay relay = BlockyCoderRelay::createRelay(blockSize, blocksPerGeneration, dataLength);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setSeeded(seeded);
+        relay.setSeeded(seeded);
+
+        // The relay forwards one packet for every packet it is sent, from the first one on
+        for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+            while (!decoder.canDecodeGeneration(i)) {
+
+                if (in.data == NULL) {
+                    in.data = Coder::allocateBlock(blockSize);
+                }
+
+                encoder.encode(in, i);
+                if (sent++ % dropEvery != 0) {
+                    relay.storeOwned(in);
+                    if (in.data == NULL) {
+                        adopted++;
+                    }
+                }
+
+                if (relay.getRank(i) == 0) {
+                    continue;
+                }
+
+                if (!relay.encode(out, i) || out.seeded) {
+                    printf("Relay failed to recode!\n");
+                    retval = false;
+                    break;
+                }
+
+                if (sent % dropEvery != 1) {
+                    decoder.store(out);
+                }
+            }
+        }
+
+        if (adopted != relay.getNumBlocks()) {
+            printf("%lu blocks adopted instead of %lu!\n", adopted, relay.getNumBlocks());
+            retval = false;
+        }
+
+        if (relay.decode() || relay.getGenerationDecoded(0)) {
+            printf("Relay decoded!\n");
+            retval = false;
+        }
+
+        if (retval && (!decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    Coder::freeBlock(in.data);
+    delete [] in.coeffs;
+    delete [] out.data;
+    delete [] out.coeffs;
+    delete [] data;
+
+    printf("testRelay(%lu, %lu, %lu, %lu%s): %s\n", blockSize, blocksPerGeneration, dataLength, dropEvery, seeded ? ", seeded" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testRankTracker(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t dropEvery, size_t nonzeros)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    BlockyPacket in, out;
+    size_t sent = 0, forwarded = 0;
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderRelay relay = BlockyCoderRelay::createRelay(blockSize, blocksPerGeneration, dataLength);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setSeeded(true);
+        encoder.setNonzeros(nonzeros);
+
+        // One tracker mirrors what the relay holds, one what the peer downstream holds
+        vector<RankTracker> held, peer;
+        for (size_t i = 0; i < relay.getNumGenerations(); i++) {
+            held.push_back(RankTracker(relay.getNumBlocksInGeneration(i)));
+            peer.push_back(RankTracker(relay.getNumBlocksInGeneration(i)));
+        }
+
+        for (size_t i = 0; i < encoder.getNumGenerations() && retval; i++) {
+            while (!decoder.canDecodeGeneration(i)) {
+
+                encoder.encode(in, i);
+                if (sent++ % dropEvery == 0) {
+                    continue;
+                }
+
+                bool tracked = in.seeded ? held[i].storeSeeded(in.seed) : held[i].store(in.coeffs);
+                if (tracked != relay.store(in) || held[i].getRank() != relay.getRank(i)) {
+                    printf("Tracker disagrees with relay!\n");
+                    retval = false;
+                    break;
+                }
+
+                if (relay.getRank(i) == 0) {
+                    continue;
+                }
+
+                relay.encode(out, i);
+                if (!peer[i].isInnovative(out.coeffs)) {
+                    continue;
+                }
+
+                forwarded++;
+                if (!peer[i].store(out.coeffs) || !decoder.store(out)) {
+                    printf("Forwarded packet was not innovative!\n");
+                    retval = false;
+                    break;
+                }
+            }
+        }
+
+        if (retval && forwarded != decoder.getNumBlocks()) {
+            printf("%lu packets forwarded instead of %lu!\n", forwarded, decoder.getNumBlocks());
+            retval = false;
+        }
+
+        if (retval && (!decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    delete [] in.data;
+    delete [] in.coeffs;
+    delete [] out.data;
+    delete [] out.coeffs;
+    delete [] data;
+
+    printf("testRankTracker(%lu, %lu, %lu, %lu, %lu): %s\n", blockSize, blocksPerGeneration, dataLength, dropEvery, nonzeros, retval ? "true" : "false");
+    return retval;
+}
+
+const char *syncModeName(BlockyCoderFile::SyncMode mode)
+{
+
+    switch (mode) {
+    case BlockyCoderFile::NO_SYNC:
+        return "no-sync";
+    case BlockyCoderFile::SYNC_GROUP:
+        return "sync-group";
+    case BlockyCoderFile::SYNC_ON_CLOSE:
+        return "sync-on-close";
+    default:
+        return "sync-every";
+    }
+
+}
+
+bool testFileSync(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, BlockyCoderFile::SyncMode mode, size_t interval, size_t numThreads)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    ThreadPool pool(numThreads);
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderFile decoder = BlockyCoderFile::createDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec");
+        decoder.setSyncMode(mode, interval);
+        decoder.setThreadPool(&pool);
+
+        if (decoder.getSyncMode() != mode || decoder.getSyncInterval() != interval) {
+            printf("Sync mode mismatch!\n");
+            retval = false;
+        }
+
+        for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+            for (size_t j = 0; j < blocksPerGeneration + 2; j++) {
+                BlockyPacket packet;
+                encoder.encode(packet, i);
+                decoder.store(packet);
+                delete [] packet.data;
+                delete [] packet.coeffs;
+            }
+        }
+
+        // Generations are flushed in parallel, with positional writes
+        if (!decoder.decode() || !decoder.flush()) {
+            printf("Decoding failed!\n");
+            retval = false;
+        }
+
+        if (mode == BlockyCoderFile::SYNC_EVERY && !decoder.sync()) {
+            printf("Sync failed!\n");
+            retval = false;
+        }
+    }
+
+    // The file is complete once the decoder is gone, and padding is left out of it
+    ifstream decfile("test.dec", ios::in|ios::binary|ios::ate);
+    if (retval && (size_t) decfile.tellg() != dataLength) {
+        printf("File size mismatch!\n");
+        retval = false;
+    }
+
+    if (retval) {
+        uint8_t *output = new uint8_t[dataLength];
+        decfile.seekg(0);
+        decfile.read((char *) output, dataLength);
+        if (memcmp(output, data, dataLength) != 0) {
+            printf("Flushed data mismatch!\n");
+            retval = false;
+        }
+        delete [] output;
+    }
+    decfile.close();
+
+    delete [] data;
+    remove("test.dec");
+
+    printf("testFileSync(%lu, %lu, %lu, %s, %lu, %lu): %s\n", blockSize, blocksPerGeneration, dataLength, syncModeName(mode), interval, numThreads, retval ? "true" : "false");
+    return retval;
+}
+
+bool testAsyncIO(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t windowSize, bool streaming, BlockyCoderFile::SyncMode mode, bool pipelined)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    ofstream encfile("test.enc", ios::out|ios::binary);
+    encfile.write((char *) data, dataLength);
+    encfile.close();
+
+    bool retval = true;
+    bool available = true;
+    {
+        BlockyCoderFile encoder = BlockyCoderFile::createStreamingEncoder(blockSize, blocksPerGeneration, "test.enc", windowSize);
+        BlockyCoderFile decoder = streaming ?
+            BlockyCoderFile::createStreamingDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec") :
+            BlockyCoderFile::createDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec");
+        decoder.setSyncMode(mode, mode == BlockyCoderFile::SYNC_GROUP ? 5 : 3);
+
+        // Without io_uring both stay synchronous, which must still work
+        available = encoder.setAsyncIO(true);
+        if (decoder.setAsyncIO(true) != available || encoder.getAsyncIO() != available || decoder.getAsyncIO() != available) {
+            printf("Async I/O mismatch!\n");
+            retval = false;
+        }
+
+        if (pipelined) {
+            decoder.startPipeline();
+        }
+
+        // Generations in order, so reads ahead are used, then a second pass that reloads the early ones
+        size_t count = blocksPerGeneration + 2;
+        for (size_t i = 0; i < encoder.getNumGenerations(); i++) {
+            for (size_t j = 0; j < count; j++) {
+
+                BlockyPacket packet;
+                if (!encoder.encode(packet, (j < count / 2 ? i : encoder.getNumGenerations() - 1 - i))) {
+                    printf("Encoding failed!\n");
+                    retval = false;
+                }
+
+                if (decoder.store(packet) && !pipelined && decoder.canDecodeGeneration(packet.generation)) {
+                    decoder.decodeGeneration(packet.generation);
+                    decoder.flushGeneration(packet.generation);
+                }
+                delete [] packet.data;
+                delete [] packet.coeffs;
+            }
+        }
+
+        if (pipelined && !decoder.finishPipeline()) {
+            printf("Pipeline failed!\n");
+            retval = false;
+        }
+
+        for (size_t k = 0; k < decoder.getNumGenerations(); k++) {
+            if (!decoder.getGenerationDecoded(k)) {
+                printf("Generation %lu not decoded!\n", k);
+                retval = false;
+                break;
+            }
+        }
+
+        // Waits for the writes in flight
+        if (!decoder.sync()) {
+            printf("Sync failed!\n");
+            retval = false;
+        }
+
+        for (size_t k = 0; k < decoder.getNumGenerations() && streaming; k++) {
+            if (decoder.getGenerationResident(k)) {
+                printf("Generation %lu not released!\n", k);
+                retval = false;
+                break;
+            }
+        }
+
+        if (!decoder.setAsyncIO(false) || decoder.getAsyncIO()) {
+            printf("Async I/O not turned off!\n");
+            retval = false;
+        }
+    }
+
+    if (retval) {
+
+        uint8_t *output = new uint8_t[dataLength];
+        ifstream decfile("test.dec", ios::in|ios::binary);
+        decfile.read((char *) output, dataLength);
+        decfile.close();
+
+        if (memcmp(output, data, dataLength) != 0) {
+            printf("Flushed data mismatch!\n");
+            retval = false;
+        }
+        delete [] output;
+    }
+
+    delete [] data;
+    remove("test.enc");
+    remove("test.dec");
+
+    printf("testAsyncIO(%lu, %lu, %lu, %lu, %s, %s%s%s): %s\n", blockSize, blocksPerGeneration, dataLength, windowSize, streaming ? "streaming" : "buffered", syncModeName(mode), pipelined ? ", pipelined" : "", available ? "" : ", synchronous", retval ? "true" : "false");
+    return retval;
+}
+
+bool testThreadPool(size_t numThreads, size_t count)
+{
+
+    ThreadPool pool(numThreads);
+    bool retval = true;
+
+    // Every iteration runs exactly once, including those of nested loops
+    vector<atomic<size_t>> runs(count);
+    for (size_t i = 0; i < count; i++) {
+        runs[i] = 0;
+    }
+    atomic<size_t> nested(0);
+    pool.parallelFor(count, [&](size_t i) {
+        runs[i]++;
+        pool.parallelFor(3, [&](size_t) { nested++; });
+    });
+
+    for (size_t i = 0; i < count; i++) {
+        if (runs[i] != 1) {
+            printf("Iteration %lu ran %lu times!\n", i, (size_t) runs[i]);
+            retval = false;
+            break;
+        }
+    }
+
+    if (nested != 3 * count) {
+        printf("%lu nested iterations instead of %lu!\n", (size_t) nested, 3 * count);
+        retval = false;
+    }
+
+    // The first exception reaches the caller, after the other iterations have run
+    atomic<size_t> completed(0);
+    bool caught = false;
+    try {
+        pool.parallelFor(count, [&](size_t i) {
+            if (i == count / 2) {
+                throw runtime_error("iteration failed");
+            }
+            completed++;
+        });
+    } catch (runtime_error&) {
+        caught = true;
+    }
+
+    if (!caught || completed != count - 1) {
+        printf("Exception not propagated!\n");
+        retval = false;
+    }
+
+    printf("testThreadPool(%lu, %lu): %s\n", numThreads, count, retval ? "true" : "false");
+    return retval;
+}
+
+template <typename B> bool testParallelTransfer(const char *name, size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numThreads, Coder::DecodingMode mode)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    ofstream encfile("test.enc", ios::out|ios::binary);
+    encfile.write((char *) data, dataLength);
+    encfile.close();
+
+    bool retval = true;
+    ThreadPool pool(numThreads);
+    {
+        B encoder = Utils::createBlockyEncoder<B>(blockSize, blocksPerGeneration, dataLength, "test.enc", data);
+        B decoder = Utils::createBlockyDecoder<B>(blockSize, blocksPerGeneration, dataLength, "test.dec", data);
+        encoder.setThreadPool(&pool);
+        decoder.setThreadPool(&pool);
+        decoder.setDecodingMode(mode);
+
+        // A few spare packets per generation cover the odd dependent one
+        size_t count = blocksPerGeneration + 4;
+        vector<BlockyPacket> packets(count * encoder.getNumGenerations());
+        if (!encoder.encodeGenerations(count, packets.data())) {
+            printf("Encoding failed!\n");
+            retval = false;
+        }
+
+        for (size_t j = 0; j < packets.size(); j++) {
+            decoder.store(packets[j]);
+            delete [] packets[j].data;
+            delete [] packets[j].coeffs;
+        }
+
+        if (retval && (!decoder.canDecode() || !decoder.decode() || !decoder.flush())) {
+            printf("Decoding failed!\n");
+            retval = false;
+        }
+
+        if (retval && memcmp(decoder.getBuffer(), data, dataLength) != 0) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    delete [] data;
+    remove("test.enc");
+    remove("test.dec");
+
+    printf("%s(%lu, %lu, %lu, %lu, %s): %s\n", name, blockSize, blocksPerGeneration, dataLength, numThreads, modeName(mode), retval ? "true" : "false");
+    return retval;
+}
+
+bool testConcurrentEncode(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numThreads, bool seeded, bool shared = false)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setSeeded(seeded);
+
+        // Shared, the encoder has locks and a pool, neither of which the senders should contend on
+        ThreadPool pool(2);
+        if (shared) {
+            encoder.setConcurrentStore();
+            encoder.setThreadPool(&pool);
+        }
+
+        // Every thread encodes from every generation; together they send a few spares each
+        size_t perThread = (blocksPerGeneration + 2 + numThreads - 1) / numThreads + 1;
+        vector<vector<BlockyPacket>> packets(numThreads);
+        vector<thread> threads;
+        atomic<size_t> failures(0);
+        for (size_t t = 0; t < numThreads; t++) {
+            threads.push_back(thread([&, t] {
+                PRNG prng(t + 1);
+                packets[t].resize(perThread * encoder.getNumGenerations());
+                for (size_t j = 0; j < packets[t].size(); j++) {
+                    if (!encoder.encode(packets[t][j], j % encoder.getNumGenerations(), prng)) {
+                        failures++;
+                    }
+                }
+            }));
+        }
+        for (size_t t = 0; t < numThreads; t++) {
+            threads[t].join();
+        }
+
+        if (failures != 0) {
+            printf("%lu packets failed to encode!\n", (size_t) failures);
+            retval = false;
+        }
+
+        for (size_t t = 0; t < numThreads; t++) {
+            for (size_t j = 0; j < packets[t].size(); j++) {
+                if (packets[t][j].seeded != seeded) {
+                    printf("Packet seeding mismatch!\n");
+                    retval = false;
+                }
+                decoder.store(packets[t][j]);
+                delete [] packets[t][j].data;
+                delete [] packets[t][j].coeffs;
+            }
+        }
+
+        if (retval && (!decoder.canDecode() || !decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    delete [] data;
+
+    printf("testConcurrentEncode(%lu, %lu, %lu, %lu%s%s): %s\n", blockSize, blocksPerGeneration, dataLength, numThreads, seeded ? ", seeded" : "", shared ? ", shared" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testConcurrentStore(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numThreads, Coder::DecodingMode mode, bool batched)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        decoder.setDecodingMode(mode);
+        if (!decoder.setConcurrentStore()) {
+            printf("Can't set concurrent store!\n");
+            retval = false;
+        }
+
+        // Interleave the generations, so every thread feeds all of them
+        size_t count = blocksPerGeneration + 4;
+        vector<BlockyPacket> packets(count * encoder.getNumGenerations());
+        for (size_t j = 0; j < packets.size(); j++) {
+            encoder.encode(packets[j], j % encoder.getNumGenerations());
+        }
+
+        atomic<size_t> helpful(0);
+        vector<thread> threads;
+        for (size_t t = 0; t < numThreads; t++) {
+            threads.push_back(thread([&, t] {
+                size_t begin = (t * packets.size()) / numThreads;
+                size_t end = ((t + 1) * packets.size()) / numThreads;
+                if (batched) {
+                    helpful += decoder.storeBatch(&packets[begin], end - begin);
+                    return;
+                }
+                for (size_t j = begin; j < end; j++) {
+                    helpful += decoder.store(packets[j]);
+                }
+            }));
+        }
+
+        // Progress can be watched while packets are being stored
+        size_t completed = 0;
+        while (completed < decoder.getNumGenerations()) {
+            size_t now = decoder.getGenerationsCompleted();
+            if (now < completed) {
+                printf("Generations completed went backwards!\n");
+                retval = false;
+                break;
+            }
+            completed = now;
+            this_thread::yield();
+        }
+
+        for (size_t t = 0; t < numThreads; t++) {
+            threads[t].join();
+        }
+
+        if (helpful != decoder.getNumBlocks()) {
+            printf("%lu helpful packets instead of %lu!\n", (size_t) helpful, decoder.getNumBlocks());
+            retval = false;
+        }
+
+        if (retval && (!decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+
+        for (size_t j = 0; j < packets.size(); j++) {
+            delete [] packets[j].data;
+            delete [] packets[j].coeffs;
+        }
+    }
+
+    delete [] data;
+
+    printf("testConcurrentStore(%lu, %lu, %lu, %lu, %s%s): %s\n", blockSize, blocksPerGeneration, dataLength, numThreads, modeName(mode), batched ? ", batched" : "", retval ? "true" : "false");
+    return retval;
+}
+
+template <typename B> bool testPipeline(const char *name, size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t numThreads, Coder::DecodingMode mode, bool verifyFileOutput, bool racingStart = false)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    ofstream encfile("test.enc", ios::out|ios::binary);
+    encfile.write((char *) data, dataLength);
+    encfile.close();
+
+    bool retval = true;
+    {
+        B encoder = Utils::createBlockyEncoder<B>(blockSize, blocksPerGeneration, dataLength, "test.enc", data);
+        B decoder = Utils::createBlockyDecoder<B>(blockSize, blocksPerGeneration, dataLength, "test.dec", data);
+        decoder.setDecodingMode(mode);
+
+        // Racing, generations come one after the other so that some complete while the pipeline starts
+        size_t count = blocksPerGeneration + 4;
+        vector<BlockyPacket> packets(count * encoder.getNumGenerations());
+        for (size_t j = 0; j < packets.size(); j++) {
+            encoder.encode(packets[j], racingStart ? j / count : j % encoder.getNumGenerations());
+        }
+
+        // The first packets go in before the pipeline starts (or while it starts), the rest while it runs
+        size_t early = packets.size() / 4;
+        if (racingStart) {
+            decoder.setConcurrentStore();
+        }
+        thread earlyStores([&] {
+            for (size_t j = 0; j < early; j++) {
+                decoder.store(packets[j]);
+            }
+        });
+        if (!racingStart) {
+            earlyStores.join();
+        }
+
+        if (!decoder.startPipeline() || decoder.startPipeline()) {
+            printf("Can't start pipeline!\n");
+            retval = false;
+        }
+
+        if (racingStart) {
+            earlyStores.join();
+        }
+
+        vector<thread> threads;
+        for (size_t t = 0; t < numThreads; t++) {
+            threads.push_back(thread([&, t] {
+                for (size_t j = early + t; j < packets.size(); j += numThreads) {
+                    decoder.store(packets[j]);
+                }
+            }));
+        }
+        for (size_t t = 0; t < numThreads; t++) {
+            threads[t].join();
+        }
+
+        if (!decoder.finishPipeline() || decoder.getPipelined()) {
+            printf("Pipeline failed!\n");
+            retval = false;
+        }
+
+        if (retval && memcmp(decoder.getBuffer(), data, dataLength) != 0) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+
+        for (size_t j = 0; j < packets.size(); j++) {
+            delete [] packets[j].data;
+            delete [] packets[j].coeffs;
+        }
+    }
+
+    if (retval && verifyFileOutput) {
+
+        uint8_t *output = new uint8_t[dataLength];
+        ifstream decfile("test.dec", ios::in|ios::binary);
+        decfile.read((char *) output, dataLength);
+        decfile.close();
+
+        if (memcmp(output, data, dataLength) != 0) {
+            printf("Flushed data mismatch!\n");
+            retval = false;
+        }
+        delete [] output;
+    }
+
+    delete [] data;
+    remove("test.enc");
+    remove("test.dec");
+
+    printf("%s(%lu, %lu, %lu, %lu, %s%s): %s\n", name, blockSize, blocksPerGeneration, dataLength, numThreads, modeName(mode), racingStart ? ", racing start" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testStreamingEncoder(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, size_t windowSize, bool seeded)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    ofstream encfile("test.enc", ios::out|ios::binary);
+    encfile.write((char *) data, dataLength);
+    encfile.close();
+
+    bool retval = true;
+    {
+        BlockyCoderFile encoder = BlockyCoderFile::createStreamingEncoder(blockSize, blocksPerGeneration, "test.enc", windowSize);
+        BlockyCoderMemory decoder = BlockyCoderMemory::createDecoder(blockSize, blocksPerGeneration, dataLength);
+        encoder.setSeeded(seeded);
+
+        if (encoder.getWindowSize() != min(windowSize, encoder.getNumGenerations())) {
+            printf("Window size mismatch!\n");
+            retval = false;
+        }
+
+        // Generations are held by the coder one at a time, so reentrant encoding is refused
+        PRNG prng(1);
+        BlockyPacket refused;
+        if (encoder.encode(refused, 0, prng)) {
+            printf("Reentrant encoding should fail!\n");
+            retval = false;
+        }
+        delete [] refused.data;
+        delete [] refused.coeffs;
+
+        // A couple of packets per generation in order, then the rest round robin, so every one evicts
+        size_t count = 2;
+        vector<BlockyPacket> packets(count * encoder.getNumGenerations());
+        if (!encoder.encodeGenerations(count, packets.data())) {
+            printf("Encoding failed!\n");
+            retval = false;
+        }
+
+        for (size_t j = 0; j < (blocksPerGeneration + 2 - count) * encoder.getNumGenerations(); j++) {
+            BlockyPacket packet;
+            if (!encoder.encode(packet, j % encoder.getNumGenerations())) {
+                printf("Encoding failed!\n");
+                retval = false;
+            }
+            packets.push_back(packet);
+        }
+
+        for (size_t j = 0; j < packets.size(); j++) {
+            decoder.store(packets[j]);
+            delete [] packets[j].data;
+            delete [] packets[j].coeffs;
+        }
+
+        if (retval && (!decoder.canDecode() || !decoder.decode() || memcmp(decoder.getBuffer(), data, dataLength) != 0)) {
+            printf("Decoded data mismatch!\n");
+            retval = false;
+        }
+    }
+
+    delete [] data;
+    remove("test.enc");
+
+    printf("testStreamingEncoder(%lu, %lu, %lu, %lu%s): %s\n", blockSize, blocksPerGeneration, dataLength, windowSize, seeded ? ", seeded" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testStreamingDecoder(size_t blockSize, size_t blocksPerGeneration, size_t dataLength, Coder::DecodingMode mode, bool pipelined)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    {
+        BlockyCoderMemory encoder = BlockyCoderMemory::createEncoder(blockSize, blocksPerGeneration, dataLength, data);
+        BlockyCoderFile decoder = BlockyCoderFile::createStreamingDecoder(blockSize, blocksPerGeneration, dataLength, "test.dec");
+        decoder.setDecodingMode(mode);
+
+        if (decoder.getBuffer() != NULL || decoder.getGenerationResident(0)) {
+            printf("Storage allocated up front!\n");
+            retval = false;
+        }
+
+        if (pipelined) {
+            decoder.startPipeline();
+        }
+
+        // Generations arrive in order, two at a time, so at most two are held
+        size_t count = blocksPerGeneration + 2;
+        size_t maxResident = 0;
+        for (size_t i = 0; i < encoder.getNumGenerations(); i += 2) {
+
+            size_t last = min(i + 2, encoder.getNumGenerations());
+            for (size_t j = 0; j < count * (last - i); j++) {
+
+                BlockyPacket packet;
+                size_t generation = i + (j % (last - i));
+                encoder.encode(packet, generation);
+                if (decoder.store(packet) && !pipelined && decoder.canDecodeGeneration(generation)) {
+                    decoder.decodeGeneration(generation);
+                    decoder.flushGeneration(generation);
+                }
+                delete [] packet.data;
+                delete [] packet.coeffs;
+
+                // The flush thread releases generations as it goes
+                size_t resident = 0;
+                for (size_t k = 0; k < decoder.getNumGenerations() && !pipelined; k++) {
+                    resident += decoder.getGenerationResident(k) ? 1 : 0;
+                }
+                maxResident = max(maxResident, resident);
+            }
+        }
+
+        if (pipelined && !decoder.finishPipeline()) {
+            printf("Pipeline failed!\n");
+            retval = false;
+        }
+
+        if (!pipelined && maxResident > 2) {
+            printf("%lu generations held at once!\n", maxResident);
+            retval = false;
+        }
+
+        for (size_t k = 0; k < decoder.getNumGenerations(); k++) {
+            if (!decoder.getGenerationDecoded(k) || decoder.getGenerationResident(k)) {
+                printf("Generation %lu not decoded and released!\n", k);
+                retval = false;
+                break;
+            }
+        }
+
+        // Flushed generations are gone, so can't be encoded from
+        BlockyPacket packet;
+        if (decoder.encode(packet, 0)) {
+            printf("Encoding from a released generation should fail!\n");
+            retval = false;
+        }
+        delete [] packet.data;
+        delete [] packet.coeffs;
+    }
+
+    if (retval) {
+
+        uint8_t *output = new uint8_t[dataLength];
+        ifstream decfile("test.dec", ios::in|ios::binary);
+        decfile.read((char *) output, dataLength);
+        decfile.close();
+
+        if (memcmp(output, data, dataLength) != 0) {
+            printf("Flushed data mismatch!\n");
+            retval = false;
+        }
+        delete [] output;
+    }
+
+    delete [] data;
+    remove("test.dec");
+
+    printf("testStreamingDecoder(%lu, %lu, %lu, %s%s): %s\n", blockSize, blocksPerGeneration, dataLength, modeName(mode), pipelined ? ", pipelined" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testStream(size_t blockSize, size_t blocksPerGeneration, size_t windowSize, size_t dataLength, size_t dropEvery, bool seeded)
+{
+
+    uint8_t *data = new uint8_t[dataLength];
+    for (size_t i = 0; i < dataLength; i++) {
+        data[i] = rand() % 256;
+    }
+
+    bool retval = true;
+    {
+        BlockyCoderStream encoder = BlockyCoderStream::createEncoder(blockSize, blocksPerGeneration, windowSize);
+        BlockyCoderStream decoder = BlockyCoderStream::createDecoder(blockSize, blocksPerGeneration, windowSize);
+        encoder.setSeeded(seeded);
+
+        // Data arrives in uneven pieces, each sealed generation is sent with losses, and
+        // undelivered generations are topped up before the next piece. Pieces seal at most
+        // a window's worth of generations, so none leaves the encoder's window undelivered.
+        vector<uint8_t> output;
+        size_t offset = 0, sent = 0, numPackets = 0;
+        size_t maxPiece = ((windowSize - 1) * encoder.getGenerationCapacity()) + 1;
+        while (offset < dataLength && retval) {
+
+            size_t length = min(dataLength - offset, (size_t) (1 + rand() % maxPiece));
+            encoder.append(&data[offset], length);
+            offset += length;
+            if (offset == dataLength) {
+                encoder.seal();
+            }
+
+            for (; sent < encoder.getNextGeneration(); sent++) {
+                for (size_t j = 0; j < blocksPerGeneration; j++) {
+                    BlockyPacket packet;
+                    encoder.encode(packet, sent);
+                    if (++numPackets % dropEvery != 0) {
+                        decoder.store(packet);
+                    }
+                    delete [] packet.data;
+                    delete [] packet.coeffs;
+                }
+            }
+
+            while (decoder.getFirstGeneration() < encoder.getNextGeneration()) {
+
+                const uint8_t *block;
+                size_t blockLength;
+                while ((block = decoder.deliver(blockLength)) != NULL) {
+                    output.insert(output.end(), block, block + blockLength);
+                }
+
+                if (decoder.getFirstGeneration() == encoder.getNextGeneration()) {
+                    break;
+                }
+
+                BlockyPacket packet;
+                if (!encoder.encode(packet, decoder.getFirstGeneration())) {
+                    printf("Generation %lu left the window undelivered!\n", decoder.getFirstGeneration());
+                    retval = false;
+                    break;
+                }
+                decoder.store(packet);
+                delete [] packet.data;
+                delete [] packet.coeffs;
+            }
+        }
+
+        if (retval && (output.size() != dataLength || memcmp(output.data(), data, dataLength) != 0)) {
+            printf("Delivered data mismatch!\n");
+            retval = false;
+        }
+
+        // Generations behind either window, or ahead of the decoder's, are refused
+        BlockyPacket packet;
+        if (encoder.getNextGeneration() > windowSize && encoder.encode(packet, 0)) {
+            printf("Encoded from a retired generation!\n");
+            retval = false;
+        }
+
+        encoder.append(data, blockSize * blocksPerGeneration);
+        encoder.encode(packet, encoder.getNextGeneration() - 1);
+        packet.generation = decoder.getFirstGeneration() + windowSize;
+        if (decoder.store(packet)) {
+            printf("Stored a packet beyond the window!\n");
+            retval = false;
+        }
+
+        if (!decoder.skipTo(packet.generation) || !decoder.store(packet) || decoder.getRank(packet.generation) != 1) {
+            printf("Skipping ahead failed!\n");
+            retval = false;
+        }
+
+        packet.generation = 0;
+        if (decoder.store(packet) || decoder.skipTo(0)) {
+            printf("Stored a packet for a delivered generation!\n");
+            retval = false;
+        }
+        delete [] packet.data;
+        delete [] packet.coeffs;
+    }
+
+    delete [] data;
+
+    printf("testStream(%lu, %lu, %lu, %lu, %lu%s): %s\n", blockSize, blocksPerGeneration, windowSize, dataLength, dropEvery, seeded ? ", seeded" : "", retval ? "true" : "false");
+    return retval;
+}
+
+bool testSeededCoefficients()
+{
+
+    const size_t blockSize = 16;
+    const size_t numBlocks = 32;
+    uint8_t data[numBlocks][blockSize];
+    uint8_t *blocks[numBlocks];
+    memset(data, 0, sizeof(data));
+    for (size_t i = 0; i < numBlocks; i++) {
+        blocks[i] = data[i];
+    }
+
+    Coder encoder1 = Coder::createEncoder(blockSize, numBlocks, blocks);
+    Coder encoder2 = Coder::createEncoder(blockSize, numBlocks, blocks);
+    encoder1.setSeed(42);
+    encoder2.setSeed(42);
+
+    // Equal seeds give equal coefficient streams, and a seed always expands the same way
+    for (size_t i = 0; i < 16; i++) {
+
+        uint8_t coeffs1[numBlocks], coeffs2[numBlocks], block[blockSize];
+        if (!encoder1.encode(block, coeffs1) || !encoder2.encode(block, coeffs2)) {
+            return false;
+        }
+
+        if (memcmp(coeffs1, coeffs2, numBlocks) != 0) {
+            printf("Coefficients differ for equal seeds!\n");
+            return false;
+        }
+
+        encoder1.expandSeed(i, coeffs1);
+        encoder2.expandSeed(i, coeffs2);
+        if (memcmp(coeffs1, coeffs2, numBlocks) != 0 || memchr(coeffs1, 0, numBlocks) != NULL) {
+            printf("Bad expansion of seed %lu!\n", i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+struct MultiTestCase {
+    size_t blockSize;
+    size_t blocksPerGeneration;
+    size_t dataLength;
+};
+
+template <typename B> bool testEndToEndBlockyCoderMulti(vector<MultiTestCase> cases, const char *name, bool verifyFileOutput = true, Coder::DecodingMode mode = Coder::ECHELON)
+{
+
+    bool retval = true;
+    for (size_t i = 0; i < cases.size(); i++) {
+        bool success = testEndToEndBlockyCoder<B>(cases[i].blockSize, cases[i].blocksPerGeneration, cases[i].dataLength, verifyFileOutput, mode);
+        printf("%s(%lu, %lu, %lu): %s\n", name, cases[i].blockSize, cases[i].blocksPerGeneration, cases[i].dataLength, success ? "true" : "false");
+        retval &= success;
+    }
+    return retval;
+}
+
+int main() {
+
+    srand(15);
+
+    vector<MultiTestCase> cases = {
+        {1, 4, 39},
+        {2048, 4, 43151},
+        {32, 16, 65537},
+        {32768, 16, 4*1048576}
+    };
+    bool success = true;
+
+    success &= testGF28Implementations();
+    success &= testGF28LinearCombination(1, 7);
+    success &= testGF28LinearCombination(16, 4097);
+    success &= testGF28LinearCombination(64, 3 * GF28::TILE_SIZE + 5);
+    success &= testGF28MatrixProduct(1, 3, 33);
+    success &= testGF28MatrixProduct(6, 16, 1000);
+    success &= testGF28MatrixProduct(16, 64, GF28::TILE_SIZE + 300);
+    success &= testGF28Striping(4, 64, 32768);
+    success &= testGF28Striping(3, 130, 7 * GF28::TILE_SIZE + 11);
+
+    bool pivoting = testCoderPivoting();
+    printf("testCoderPivoting: %s\n", pivoting ? "true" : "false");
+    success &= pivoting;
+    success &= testEndToEndBlockyCoderMulti<BlockyCoderMemory>(cases, "testEndToEndBlockyCoderMemory", false);
+    success &= testEndToEndBlockyCoderMulti<BlockyCoderFile>(cases, "testEndToEndBlockyCoderFile");
+    success &= testEndToEndBlockyCoderMulti<BlockyCoderMmap>(cases, "testEndToEndBlockyCoderMmap");
+    success &= testLossyTransfer(64, 16, 65537, 3, Coder::ECHELON, true, false, 0);
+    success &= testLossyTransfer(64, 16, 65537, 3, Coder::GAUSS_JORDAN, true, false, 0);
+    success &= testLossyTransfer(1024, 64, 1048576, 10, Coder::ECHELON, true, false, 0);
+    success &= testLossyTransfer(64, 16, 65537, 3, Coder::ECHELON, false, true, 0);
+    success &= testLossyTransfer(1024, 256, 1048576, 10, Coder::GAUSS_JORDAN, true, true, 0);
+    success &= testLossyTransfer(64, 64, 65537, 5, Coder::ECHELON, false, false, 4);
+    success &= testLossyTransfer(64, 64, 65537, 5, Coder::GAUSS_JORDAN, false, true, 4);
+    success &= testLossyTransfer(64, 16, 65537, 3, Coder::DEFERRED, false, false, 0);
+    success &= testLossyTransfer(1024, 256, 1048576, 10, Coder::DEFERRED, true, true, 0);
+
+    success &= testAugmentedDecoder(100, 10, Coder::ECHELON);
+    success &= testAugmentedDecoder(4096, 64, Coder::GAUSS_JORDAN);
+    success &= testAugmentedDecoder(1000, 70, Coder::DEFERRED);
+
+    success &= testAllocationFree(1024, 16);
+    success &= testAllocationFree(65536, 16);
+
+    success &= testEncodeBatch(64, 16, 65537, 8, false, false);
+    success &= testEncodeBatch(1024, 64, 1048576, 32, true, false);
+    success &= testEncodeBatch(1000, 32, 100000, 5, true, true);
+
+    success &= testStoreBatch(64, 16, 65537, 8, Coder::ECHELON, false, false);
+    success &= testStoreBatch(64, 16, 65537, 32, Coder::GAUSS_JORDAN, false, false);
+    success &= testStoreBatch(1000, 32, 100000, 48, Coder::ECHELON, true, true);
+    success &= testStoreBatch(1024, 64, 1048576, 64, Coder::GAUSS_JORDAN, true, false);
+    success &= testStoreBatch(1000, 32, 100000, 48, Coder::DEFERRED, false, true);
+
+    success &= testStoreOwned(64, 16, 65537, 3, Coder::DEFERRED, false);
+    success &= testStoreOwned(1000, 32, 100000, 5, Coder::DEFERRED, true);
+    success &= testStoreOwned(64, 16, 65537, 3, Coder::ECHELON, false);
+
+    success &= testRelay(64, 16, 65537, 3, false);
+    success &= testRelay(1000, 32, 100000, 5, true);
+
+    success &= testRankTracker(64, 16, 65537, 3, 4);
+    success &= testRankTracker(1000, 32, 100000, 5, 0);
+
+    success &= testConcurrentEncode(64, 16, 65537, 4, false);
+    success &= testConcurrentEncode(1000, 32, 100000, 3, true);
+    success &= testConcurrentEncode(32768, 32, 2*1048576, 4, false, true);
+
+    success &= testConcurrentStore(64, 16, 65537, 4, Coder::ECHELON, false);
+    success &= testConcurrentStore(1000, 32, 100000, 3, Coder::GAUSS_JORDAN, false);
+    success &= testConcurrentStore(1024, 16, 1048576, 4, Coder::DEFERRED, true);
+
+    success &= testPipeline<BlockyCoderMemory>("testPipelineMemory", 1024, 16, 1048576 + 5, 3, Coder::ECHELON, false);
+    success &= testPipeline<BlockyCoderFile>("testPipelineFile", 1024, 16, 1048576 + 5, 3, Coder::GAUSS_JORDAN, true);
+    success &= testPipeline<BlockyCoderMmap>("testPipelineMmap", 1000, 32, 100000, 2, Coder::DEFERRED, true);
+    success &= testPipeline<BlockyCoderMemory>("testPipelineMemory", 64, 4, 65536, 2, Coder::ECHELON, false, true);
+    success &= testPipeline<BlockyCoderFile>("testPipelineFile", 64, 4, 65536, 2, Coder::GAUSS_JORDAN, true, true);
+
+    success &= testStreamingEncoder(64, 16, 65537, 1, false);
+    success &= testStreamingEncoder(1000, 32, 100000, 3, true);
+    success &= testStreamingEncoder(1024, 16, 1048576, 100, false);
+
+    success &= testStreamingDecoder(64, 16, 65537, Coder::ECHELON, false);
+    success &= testStreamingDecoder(1000, 32, 100000, Coder::GAUSS_JORDAN, false);
+    success &= testStreamingDecoder(1000, 32, 100000, Coder::DEFERRED, false);
+    success &= testStreamingDecoder(1024, 16, 1048576 + 5, Coder::ECHELON, true);
+
+    success &= testStream(64, 16, 4, 65537, 3, false);
+    success &= testStream(1000, 32, 2, 100000, 5, true);
+    success &= testStream(1024, 16, 8, 1048576, 10, false);
+
+    success &= testFileSync(64, 16, 65537, BlockyCoderFile::SYNC_EVERY, 1, 1);
+    success &= testFileSync(1000, 32, 100000, BlockyCoderFile::SYNC_EVERY, 4, 3);
+    success &= testFileSync(1024, 16, 1048576 + 5, BlockyCoderFile::SYNC_GROUP, 5, 4);
+    success &= testFileSync(1024, 16, 1048576 + 5, BlockyCoderFile::SYNC_ON_CLOSE, 1, 4);
+    success &= testFileSync(64, 16, 65537, BlockyCoderFile::NO_SYNC, 1, 2);
+
+    success &= testAsyncIO(64, 16, 65537, 1, true, BlockyCoderFile::SYNC_EVERY, false);
+    success &= testAsyncIO(1000, 32, 100000, 3, false, BlockyCoderFile::SYNC_EVERY, false);
+    success &= testAsyncIO(1024, 16, 1048576 + 5, 8, true, BlockyCoderFile::SYNC_GROUP, true);
+    success &= testAsyncIO(1024, 16, 1048576 + 5, 100, false, BlockyCoderFile::NO_SYNC, true);
+
+    success &= testThreadPool(1, 10);
+    success &= testThreadPool(4, 1000);
+    success &= testParallelTransfer<BlockyCoderMemory>("testParallelTransferMemory", 1024, 16, 1048576 + 5, 4, Coder::ECHELON);
+    success &= testParallelTransfer<BlockyCoderMemory>("testParallelTransferMemory", 1000, 32, 100000, 3, Coder::DEFERRED);
+    success &= testParallelTransfer<BlockyCoderFile>("testParallelTransferFile", 1024, 16, 1048576 + 5, 4, Coder::GAUSS_JORDAN);
+    success &= testParallelTransfer<BlockyCoderMmap>("testParallelTransferMmap", 1024, 16, 1048576 + 5, 4, Coder::ECHELON);
+    success &= testParallelTransfer<BlockyCoderMemory>("testParallelTransferMemory", 32768, 64, 2*1048576 + 1000, 4, Coder::ECHELON);
+    success &= testParallelTransfer<BlockyCoderMemory>("testParallelTransferMemory", 32768, 64, 2*1048576, 4, Coder::GAUSS_JORDAN);
+    success &= testParallelTransfer<BlockyCoderMemory>("testParallelTransferMemory", 32768, 64, 2*1048576, 4, Coder::DEFERRED);
+
+    bool seeds = testSeededCoefficients();
+    printf("testSeededCoefficients: %s\n", seeds ? "true" : "false");
+    success &= seeds;
+
+    success &= testEndToEndBlockyCoderMulti<BlockyCoderMemory>(cases, "testEndToEndBlockyCoderMemoryGaussJordan", false, Coder::GAUSS_JORDAN);
+    success &= testEndToEndBlockyCoderMulti<BlockyCoderFile>(cases, "testEndToEndBlockyCoderFileGaussJordan", true, Coder::GAUSS_JORDAN);
+    success &= testEndToEndBlockyCoderMulti<BlockyCoderMmap>(cases, "testEndToEndBlockyCoderMmapGaussJordan", true, Coder::GAUSS_JORDAN);
+    success &= testEndToEndBlockyCoderMulti<BlockyCoderMemory>(cases, "testEndToEndBlockyCoderMemoryDeferred", false, Coder::DEFERRED);
+    success &= testEndToEndBlockyCoderMulti<BlockyCoderFile>(cases, "testEndToEndBlockyCoderFileDeferred", true, Coder::DEFERRED);
 
     if (success) {
         printf("All tests passed!\n");
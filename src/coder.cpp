@@ -8,27 +8,58 @@
 
 #include "coder.h"
 #include <algorithm>
+#include <new>
+#include <random>
+#include <vector>
 
 using namespace blocky;
 
+const size_t Coder::RECORD_ALIGNMENT;
+
 Coder::Coder() :
     decoded(false),
+    mode(ECHELON),
+    systematic(false),
+    systematicIndex(0),
+    nonzeros(0),
     blockSize(0),
     numBlocks(0),
     rank(0),
     coeffs(NULL),
-    blocks(NULL)
+    rawCoeffs(NULL),
+    owned(NULL),
+    blocks(NULL),
+    row(NULL),
+    multipliers(NULL),
+    sources(NULL),
+    drawn(NULL),
+    rowEnds(NULL),
+    storage(NULL),
+    stride(0)
 {
 
 }
 
 Coder::Coder(size_t _blockSize, size_t _numBlocks) :
     decoded(false),
+    mode(ECHELON),
+    systematic(false),
+    systematicIndex(0),
+    nonzeros(0),
     blockSize(_blockSize),
     numBlocks(_numBlocks),
     rank(0),
     coeffs(NULL),
-    blocks(NULL)
+    rawCoeffs(NULL),
+    owned(NULL),
+    blocks(NULL),
+    row(NULL),
+    multipliers(NULL),
+    sources(NULL),
+    drawn(NULL),
+    rowEnds(NULL),
+    storage(NULL),
+    stride(0)
 {
 
     coeffs = new uint8_t*[numBlocks];
@@ -38,16 +69,38 @@ Coder::Coder(size_t _blockSize, size_t _numBlocks) :
     }
 
     blocks = new uint8_t*[numBlocks];
+    row = new uint8_t[numBlocks];
+    multipliers = new uint8_t[numBlocks];
+    sources = new uint8_t*[numBlocks];
+    drawn = new uint8_t[numBlocks];
+    rowEnds = new size_t[numBlocks];
+    memset(rowEnds, 0, numBlocks * sizeof(size_t));
+
+    std::random_device device;
+    prng.seed(((uint64_t) device() << 32) | device());
 
 }
 
 Coder::Coder(size_t _blockSize, size_t _numBlocks, uint8_t **_blocks) :
     decoded(true),
+    mode(ECHELON),
+    systematic(false),
+    systematicIndex(0),
+    nonzeros(0),
     blockSize(_blockSize),
     numBlocks(_numBlocks),
     rank(_numBlocks),
     coeffs(NULL),
-    blocks(NULL)
+    rawCoeffs(NULL),
+    owned(NULL),
+    blocks(NULL),
+    row(NULL),
+    multipliers(NULL),
+    sources(NULL),
+    drawn(NULL),
+    rowEnds(NULL),
+    storage(NULL),
+    stride(0)
 {
 
     coeffs = new uint8_t*[numBlocks];
@@ -58,25 +111,81 @@ Coder::Coder(size_t _blockSize, size_t _numBlocks, uint8_t **_blocks) :
         blocks[i] = _blocks[i];
         coeffs[i][i] = 1;
     }
+    row = new uint8_t[numBlocks];
+    multipliers = new uint8_t[numBlocks];
+    sources = new uint8_t*[numBlocks];
+    drawn = new uint8_t[numBlocks];
+    rowEnds = new size_t[numBlocks];
+    for (size_t i = 0; i < numBlocks; i++) {
+        rowEnds[i] = i + 1;
+    }
+
+    std::random_device device;
+    prng.seed(((uint64_t) device() << 32) | device());
 
 }
 
 
 Coder::Coder(const Coder& other) :
     decoded(other.decoded),
+    mode(other.mode),
+    systematic(other.systematic),
+    systematicIndex(other.systematicIndex),
+    nonzeros(other.nonzeros),
     blockSize(other.blockSize),
     numBlocks(other.numBlocks),
     rank(other.rank),
     coeffs(NULL),
-    blocks(NULL)
+    rawCoeffs(NULL),
+    owned(NULL),
+    blocks(NULL),
+    row(NULL),
+    multipliers(NULL),
+    sources(NULL),
+    drawn(NULL),
+    rowEnds(NULL),
+    storage(NULL),
+    stride(other.stride),
+    prng(other.prng),
+    gf(other.gf)
 {
 
     coeffs = new uint8_t*[numBlocks];
     blocks = new uint8_t*[numBlocks];
-    for (size_t i = 0; i < numBlocks; i++) {
-        coeffs[i] = new uint8_t[numBlocks];
-        memcpy(coeffs[i], other.coeffs[i], numBlocks);
-        blocks[i] = other.blocks[i];
+    if (other.storage) {
+        allocateRecords();
+        memcpy(storage, other.storage, numBlocks * stride);
+    } else {
+        for (size_t i = 0; i < numBlocks; i++) {
+            coeffs[i] = new uint8_t[numBlocks];
+            memcpy(coeffs[i], other.coeffs[i], numBlocks);
+            blocks[i] = other.blocks[i];
+        }
+    }
+    row = new uint8_t[numBlocks];
+    multipliers = new uint8_t[numBlocks];
+    sources = new uint8_t*[numBlocks];
+    drawn = new uint8_t[numBlocks];
+    rowEnds = new size_t[numBlocks];
+    memcpy(rowEnds, other.rowEnds, numBlocks * sizeof(size_t));
+
+    if (other.rawCoeffs) {
+        rawCoeffs = new uint8_t*[numBlocks];
+        for (size_t i = 0; i < numBlocks; i++) {
+            rawCoeffs[i] = new uint8_t[numBlocks];
+            memcpy(rawCoeffs[i], other.rawCoeffs[i], numBlocks);
+        }
+    }
+
+    if (other.owned) {
+        owned = new uint8_t*[numBlocks];
+        for (size_t i = 0; i < numBlocks; i++) {
+            owned[i] = NULL;
+            if (other.owned[i]) {
+                owned[i] = allocateBlock(blockSize);
+                memcpy(owned[i], other.owned[i], blockSize);
+            }
+        }
     }
 
 }
@@ -93,16 +202,53 @@ Coder::~Coder()
 {
 
     if (coeffs) {
-        for (size_t i = 0; i < numBlocks; i++) {
+        for (size_t i = 0; i < numBlocks && !storage; i++) {
             delete [] coeffs[i];
         }
 
         delete [] coeffs;
     }
 
+    if (storage) {
+        free(storage);
+    }
+
+    if (rawCoeffs) {
+        for (size_t i = 0; i < numBlocks; i++) {
+            delete [] rawCoeffs[i];
+        }
+
+        delete [] rawCoeffs;
+    }
+
+    if (owned) {
+        releaseOwned();
+        delete [] owned;
+    }
+
     if (blocks) {
         delete [] blocks;
     }
+
+    if (row) {
+        delete [] row;
+    }
+
+    if (multipliers) {
+        delete [] multipliers;
+    }
+
+    if (sources) {
+        delete [] sources;
+    }
+
+    if (drawn) {
+        delete [] drawn;
+    }
+
+    if (rowEnds) {
+        delete [] rowEnds;
+    }
 }
 
 Coder& Coder::operator =(Coder& other)
@@ -126,11 +272,26 @@ void Coder::swap(Coder& first, Coder& second)
 
     using std::swap;
     swap(first.decoded, second.decoded);
+    swap(first.mode, second.mode);
+    swap(first.systematic, second.systematic);
+    swap(first.systematicIndex, second.systematicIndex);
+    swap(first.nonzeros, second.nonzeros);
     swap(first.blockSize, second.blockSize);
     swap(first.numBlocks, second.numBlocks);
     swap(first.rank, second.rank);
     swap(first.coeffs, second.coeffs);
+    swap(first.rawCoeffs, second.rawCoeffs);
+    swap(first.owned, second.owned);
     swap(first.blocks, second.blocks);
+    swap(first.row, second.row);
+    swap(first.multipliers, second.multipliers);
+    swap(first.sources, second.sources);
+    swap(first.drawn, second.drawn);
+    swap(first.rowEnds, second.rowEnds);
+    swap(first.storage, second.storage);
+    swap(first.stride, second.stride);
+    swap(first.prng, second.prng);
+    swap(first.gf, second.gf);
 
 }
 
@@ -141,10 +302,56 @@ Coder Coder::createEncoder(size_t _blockSize, size_t _numBlocks, uint8_t **_bloc
 
 }
 
-Coder Coder::createDecoder(size_t _blockSize, size_t _numBlocks) 
+Coder Coder::createDecoder(size_t _blockSize, size_t _numBlocks, uint8_t **_blocks) 
 {
 
-    return Coder(_blockSize, _numBlocks);
+    Coder decoder(_blockSize, _numBlocks);
+    for (size_t i = 0; i < _numBlocks; i++) {
+        decoder.blocks[i] = _blocks[i];
+    }
+    return decoder;
+
+}
+
+Coder Coder::createDecoder(size_t _blockSize, size_t _numBlocks)
+{
+
+    Coder decoder(_blockSize, _numBlocks);
+    for (size_t i = 0; i < _numBlocks; i++) {
+        delete [] decoder.coeffs[i];
+    }
+    decoder.allocateRecords();
+    return decoder;
+
+}
+
+Coder Coder::createRecoder(size_t _blockSize, size_t _numBlocks)
+{
+
+    Coder recoder = createDecoder(_blockSize, _numBlocks);
+    recoder.setDecodingMode(RECODING);
+    return recoder;
+
+}
+
+void Coder::allocateRecords()
+{
+
+    // Each record is [coeffs | padding | payload | padding], with both halves aligned
+    size_t payloadOffset = alignRecord(numBlocks);
+    stride = payloadOffset + alignRecord(blockSize);
+
+    void *memory;
+    if (posix_memalign(&memory, RECORD_ALIGNMENT, numBlocks * stride) != 0) {
+        throw std::bad_alloc();
+    }
+
+    storage = (uint8_t *) memory;
+    memset(storage, 0, numBlocks * stride);
+    for (size_t i = 0; i < numBlocks; i++) {
+        coeffs[i] = &storage[i * stride];
+        blocks[i] = coeffs[i] + payloadOffset;
+    }
 
 }
 
@@ -152,21 +359,164 @@ bool Coder::store(uint8_t *block, uint8_t *_coeffs)
 {
 
     if (canDecode()) {
-        return true;
+        return false;
     }
 
-    bool increasesRank = gaussianElimination(_coeffs);
-    if (!increasesRank) {
-        return false;
+    size_t pivot;
+    if (!storeUncoded(block, _coeffs, pivot)) {
+
+        if (!gaussianElimination(_coeffs, pivot)) {
+            return false;
+        }
+
+        if (keepsReceived()) {
+            memcpy(blocks[pivot], block, blockSize);
+        } else {
+            rowOperations(block, pivot);
+        }
     }
 
-    // Gaussian elimination would have upped rank
-    blocks[rank-1] = block;
-    rowOperations();
+    if (mode == GAUSS_JORDAN) {
+        eliminateColumn(pivot);
+    } else if (keepsReceived()) {
+        memcpy(rawCoeffs[pivot], _coeffs, numBlocks);
+    }
 
     return true;
 }
 
+bool Coder::store(uint8_t *block, uint8_t *_coeffs, bool& adopted)
+{
+
+    adopted = false;
+    if (!keepsReceived()) {
+        return store(block, _coeffs);
+    }
+
+    // The rank test only needs the coefficients; a helpful block is kept where it is
+    size_t pivot;
+    if (!gaussianElimination(_coeffs, pivot)) {
+        return false;
+    }
+
+    memcpy(rawCoeffs[pivot], _coeffs, numBlocks);
+    owned[pivot] = block;
+    adopted = true;
+    return true;
+
+}
+
+bool Coder::storeSeeded(uint8_t *block, uint32_t seed, bool& adopted)
+{
+
+    adopted = false;
+    if (canDecode()) {
+        return false;
+    }
+
+    expandSeed(seed, drawn);
+    return store(block, drawn, adopted);
+
+}
+
+uint8_t* Coder::allocateBlock(size_t size)
+{
+
+    void *memory;
+    if (posix_memalign(&memory, RECORD_ALIGNMENT, alignRecord(size)) != 0) {
+        throw std::bad_alloc();
+    }
+    return (uint8_t *) memory;
+
+}
+
+void Coder::freeBlock(uint8_t *block)
+{
+    free(block);
+}
+
+uint8_t** Coder::heldBlocks()
+{
+
+    if (owned == NULL || decoded) {
+        return blocks;
+    }
+
+    for (size_t i = 0; i < numBlocks; i++) {
+        sources[i] = owned[i] ? owned[i] : blocks[i];
+    }
+    return sources;
+
+}
+
+void Coder::releaseOwned()
+{
+
+    for (size_t i = 0; i < numBlocks; i++) {
+        if (owned[i]) {
+            freeBlock(owned[i]);
+            owned[i] = NULL;
+        }
+    }
+
+}
+
+size_t Coder::storeBatch(uint8_t **_blocks, uint8_t **_coeffs, size_t count)
+{
+
+    uint8_t **received = new uint8_t*[count];
+    size_t *pivots = new size_t[count];
+    size_t *stored = new size_t[count];
+    uint8_t *batchMultipliers = new uint8_t[count * numBlocks];
+    size_t numStored = 0, numReceived = 0;
+
+    // Rank tests on the coefficients alone; payloads of coded blocks are combined afterwards
+    for (size_t j = 0; j < count && !canDecode(); j++) {
+
+        size_t pivot;
+        if (!storeUncoded(_blocks[j], _coeffs[j], pivot)) {
+
+            if (!gaussianElimination(_coeffs[j], pivot)) {
+                continue;
+            }
+
+            if (keepsReceived()) {
+                memcpy(blocks[pivot], _blocks[j], blockSize);
+                memcpy(rawCoeffs[pivot], _coeffs[j], numBlocks);
+                stored[numStored++] = pivot;
+                continue;
+            }
+
+            received[numReceived] = _blocks[j];
+            pivots[numReceived] = pivot;
+            memcpy(&batchMultipliers[numReceived * numBlocks], multipliers, numBlocks);
+            numReceived++;
+
+        } else if (keepsReceived()) {
+            memcpy(rawCoeffs[pivot], _coeffs[j], numBlocks);
+        }
+
+        stored[numStored++] = pivot;
+    }
+
+    rowOperationsBatch(received, pivots, batchMultipliers, numReceived);
+
+    // Deferred until every block of the batch is in place
+    if (mode == GAUSS_JORDAN) {
+        for (size_t j = 0; j < numStored; j++) {
+            eliminateColumn(stored[j]);
+        }
+    }
+
+    delete [] received;
+    delete [] pivots;
+    delete [] stored;
+    delete [] batchMultipliers;
+
+    return numStored;
+
+}
+
 bool Coder::decode() 
 {
 
@@ -174,11 +524,17 @@ bool Coder::decode()
         return true;
     }
 
-    if (!canDecode()) {
+    // A recoder only ever forwards combinations of what it has received
+    if (mode == RECODING || !canDecode()) {
         return false;
     }
 
-    backSubstitution();
+    // Gauss-Jordan elimination has already reduced every row to a unit vector
+    if (mode == DEFERRED) {
+        applyInverse();
+    } else if (mode != GAUSS_JORDAN) {
+        backSubstitution();
+    }
 
     for (size_t i = 0; i < numBlocks; i++) {
         for (size_t j = 0; j < numBlocks; j++) {
@@ -188,6 +544,7 @@ bool Coder::decode()
                 coeffs[i][j] = 0;
             }
         }
+        rowEnds[i] = i + 1;
     }
 
     decoded = true;
@@ -195,114 +552,463 @@ bool Coder::decode()
 
 }
 
-bool Coder::encode(uint8_t *block, uint8_t *_coeffs) 
+bool Coder::setDecodingMode(DecodingMode _mode)
 {
 
-    if (rank == 0) {
+    if (rank != 0 && !decoded) {
         return false;
     }
 
-    uint8_t *mcoeffs = new uint8_t[numBlocks];
+    // Blocks are kept as received in these modes, so their coefficients must be too
+    if ((_mode == DEFERRED || _mode == RECODING) && rawCoeffs == NULL) {
+        rawCoeffs = new uint8_t*[numBlocks];
+        owned = new uint8_t*[numBlocks];
+        for (size_t i = 0; i < numBlocks; i++) {
+            rawCoeffs[i] = new uint8_t[numBlocks];
+            owned[i] = NULL;
+        }
+    }
+
+    mode = _mode;
+    return true;
+
+}
 
-    memset(mcoeffs, 0, numBlocks);
-    memset(_coeffs, 0, numBlocks);
-    memset(block, 0, blockSize);
+void Coder::setBlocks(uint8_t **_blocks)
+{
 
-    for (size_t i = 0; i < rank; i++) {
-        while ((mcoeffs[i] = (uint8_t) (rand() % 256)) == 0);
+    for (size_t i = 0; i < numBlocks; i++) {
+        blocks[i] = _blocks[i];
     }
 
-    for (size_t i = 0; i < rank; i++) {
+}
+
+void Coder::setSystematic(bool _systematic)
+{
 
-        gf.addMultiple(mcoeffs[i], block, blocks[i], blockSize);
-        gf.addMultiple(mcoeffs[i], _coeffs, coeffs[i], numBlocks);
+    systematic = _systematic;
+    systematicIndex = 0;
 
+}
+
+void Coder::setNonzeros(size_t _nonzeros)
+{
+
+    nonzeros = _nonzeros;
+
+}
+
+bool Coder::isBlockDecoded(size_t i)
+{
+
+    if (decoded) {
+        return true;
+    }
+
+    // Blocks are still as received
+    if (keepsReceived()) {
+        return false;
     }
 
-    delete [] mcoeffs;
+    // Entries before the pivot are always zero
+    if (coeffs[i][i] == 0) {
+        return false;
+    }
+
+    for (size_t j = i+1; j < rowEnds[i]; j++) {
+        if (coeffs[i][j] != 0) {
+            return false;
+        }
+    }
 
     return true;
+
 }
 
-bool Coder::gaussianElimination(uint8_t *_coeffs) 
+bool Coder::encode(uint8_t *block, uint8_t *_coeffs) 
 {
 
-    if (canDecode()) {
+    if (rank == 0) {
         return false;
     }
 
-    // Copy the coeffs buffer to work on
-    uint8_t **cfs = new uint8_t*[numBlocks];
-    for (size_t i = 0; i < numBlocks; i++) {
-        cfs[i] = new uint8_t[numBlocks];
-        memcpy(cfs[i], coeffs[i], numBlocks);
+    // Systematic packets are the original blocks, in order
+    if (systematic && decoded && systematicIndex < numBlocks) {
+
+        memset(_coeffs, 0, numBlocks);
+        _coeffs[systematicIndex] = 1;
+        memcpy(block, blocks[systematicIndex], blockSize);
+        systematicIndex++;
+        return true;
     }
-    memcpy(cfs[rank], _coeffs, numBlocks);
 
+    drawCoefficients();
 
-    // Gaussian elimination
-    for (size_t k = 0; k < numBlocks - 1; k++) {
+    gf.linearCombination(block, drawn, heldBlocks(), numBlocks, blockSize);
 
-        uint8_t ckk = cfs[k][k];
-        for (size_t i = k+1; i < numBlocks; i++) {
-            uint8_t cik = gf.div(gf.sub(0, cfs[i][k]), ckk);
-            cfs[i][k] = cik;
+    // The rows are the identity once all original blocks are present
+    if (decoded) {
+        memcpy(_coeffs, drawn, numBlocks);
+    } else {
+        gf.linearCombination(_coeffs, drawn, getBlockCoeffs(), numBlocks, numBlocks);
+    }
 
-            for (size_t j = k+1; j < numBlocks; j++) {
-                cfs[i][j] = gf.add(cfs[i][j], gf.mul(cik, cfs[k][j]));
+    return true;
+}
+
+void Coder::drawCoefficients(uint8_t *_drawn, PRNG& _prng) const
+{
+
+    // Only combine rows that are present, the others have no block behind them
+    if (nonzeros == 0 || nonzeros >= rank) {
+
+        _prng.nonzeroBytes(_drawn, numBlocks);
+        for (size_t i = 0; i < numBlocks; i++) {
+            if (coeffs[i][i] == 0) {
+                _drawn[i] = 0;
             }
         }
+        return;
+    }
+
+    memset(_drawn, 0, numBlocks);
+    for (size_t picked = 0; picked < nonzeros; ) {
 
+        size_t i = _prng.next() % numBlocks;
+        if (_drawn[i] != 0 || coeffs[i][i] == 0) {
+            continue;
+        }
+
+        _prng.nonzeroBytes(&_drawn[i], 1);
+        picked++;
     }
 
-    // Compute new rank
-    size_t _rank = 0;
-    for (size_t i = 0; i < numBlocks; i++) {
-        // TODO: Be less strict and reject fewer packets?
-        //for (size_t j = i; j < numBlocks; j++) {
-            if (cfs[i][i] != 0) {
-                _rank++;
-                //break;
-            //}
+}
+
+bool Coder::encodeBatch(uint8_t **_blocks, uint8_t **_coeffs, size_t count)
+{
+
+    if (rank == 0) {
+        return false;
+    }
+
+    // Pending systematic blocks go out first, uncoded
+    size_t first = 0;
+    while (first < count && systematic && decoded && systematicIndex < numBlocks) {
+        encode(_blocks[first], _coeffs[first]);
+        first++;
+    }
+
+    for (size_t j = first; j < count; j++) {
+        drawCoefficients();
+        memcpy(_coeffs[j], drawn, numBlocks);
+    }
+
+    gf.matrixProduct(&_blocks[first], &_coeffs[first], count - first, heldBlocks(), numBlocks, blockSize);
+
+    // Express the drawn combinations of rows in terms of the original blocks
+    if (!decoded) {
+        for (size_t j = first; j < count; j++) {
+            gf.linearCombination(row, _coeffs[j], getBlockCoeffs(), numBlocks, numBlocks);
+            memcpy(_coeffs[j], row, numBlocks);
         }
     }
 
-    // Clean up and copy new coeffs if needed
+    return true;
+
+}
+
+bool Coder::canEncodeSeeded()
+{
+
+    // With all original blocks present the coefficient vector is exactly the drawn one.
+    // Seeds always expand to dense vectors.
+    return canSeed() && !(systematic && systematicIndex < numBlocks);
+
+}
+
+bool Coder::encodeSeeded(uint8_t *block, uint32_t& seed)
+{
+
+    if (!canEncodeSeeded()) {
+        return false;
+    }
+
+    seed = prng.next();
+    expandSeed(seed, drawn);
+    gf.linearCombination(block, drawn, blocks, numBlocks, blockSize);
+
+    return true;
+
+}
+
+bool Coder::encode(uint8_t *block, uint8_t *_coeffs, PRNG& _prng) const
+{
+
+    if (rank == 0) {
+        return false;
+    }
+
+    // Striping would serialize concurrent callers on the thread pool
+    GF28 serial;
+    if (decoded) {
+        drawCoefficients(_coeffs, _prng);
+        serial.linearCombination(block, _coeffs, blocks, numBlocks, blockSize);
+        return true;
+    }
+
+    // Recoding can't share the scratch encode() keeps in the coder, so each thread keeps
+    // its own, grown to the largest generation it has seen rather than allocated per packet
+    thread_local std::vector<uint8_t> _drawn;
+    thread_local std::vector<uint8_t *> held;
+    if (held.size() < numBlocks) {
+        _drawn.resize(numBlocks);
+        held.resize(numBlocks);
+    }
+
     for (size_t i = 0; i < numBlocks; i++) {
-        if (_rank > rank) {
-            memcpy(coeffs[i], cfs[i], numBlocks);
+        held[i] = (owned && owned[i]) ? owned[i] : blocks[i];
+    }
+
+    drawCoefficients(_drawn.data(), _prng);
+    serial.linearCombination(block, _drawn.data(), held.data(), numBlocks, blockSize);
+    serial.linearCombination(_coeffs, _drawn.data(), getBlockCoeffs(), numBlocks, numBlocks);
+    return true;
+
+}
+
+bool Coder::encodeSeeded(uint8_t *block, uint32_t& seed, uint8_t *_coeffs, PRNG& _prng) const
+{
+
+    if (!canSeed()) {
+        return false;
+    }
+
+    seed = _prng.next();
+    expandSeed(seed, _coeffs);
+    GF28 serial;
+    serial.linearCombination(block, _coeffs, blocks, numBlocks, blockSize);
+
+    return true;
+
+}
+
+bool Coder::encodeSeededBatch(uint8_t **_blocks, uint8_t **_coeffs, uint32_t *seeds, size_t count, size_t& unseeded)
+{
+
+    unseeded = 0;
+    while (unseeded < count && systematic && decoded && systematicIndex < numBlocks) {
+        encode(_blocks[unseeded], _coeffs[unseeded]);
+        unseeded++;
+    }
+
+    if (!canEncodeSeeded()) {
+        bool retval = encodeBatch(&_blocks[unseeded], &_coeffs[unseeded], count - unseeded);
+        unseeded = count;
+        return retval;
+    }
+
+    for (size_t j = unseeded; j < count; j++) {
+        seeds[j] = prng.next();
+        expandSeed(seeds[j], _coeffs[j]);
+    }
+
+    gf.matrixProduct(&_blocks[unseeded], &_coeffs[unseeded], count - unseeded, blocks, numBlocks, blockSize);
+
+    return true;
+
+}
+
+bool Coder::storeSeeded(uint8_t *block, uint32_t seed)
+{
+
+    if (canDecode()) {
+        return false;
+    }
+
+    expandSeed(seed, drawn);
+    return store(block, drawn);
+
+}
+
+void Coder::expandSeed(uint32_t seed, uint8_t *_coeffs) const
+{
+
+    PRNG expander(seed);
+    expander.nonzeroBytes(_coeffs, numBlocks);
+
+}
+
+bool Coder::storeUncoded(uint8_t *block, uint8_t *_coeffs, size_t& pivot)
+{
+
+    pivot = numBlocks;
+    for (size_t k = 0; k < numBlocks; k++) {
+
+        if (_coeffs[k] == 0) {
+            continue;
         }
-        delete [] cfs[i];
+
+        if (_coeffs[k] != 1 || pivot != numBlocks) {
+            return false;
+        }
+
+        pivot = k;
     }
-    delete [] cfs;
 
-    if (_rank > rank) {
-        rank = _rank;
-        return true;
-    } else {
+    // A unit vector for a column without a row is already fully reduced
+    if (pivot == numBlocks || coeffs[pivot][pivot] != 0) {
         return false;
     }
 
+    memset(coeffs[pivot], 0, numBlocks);
+    coeffs[pivot][pivot] = 1;
+    rowEnds[pivot] = pivot + 1;
+    memcpy(blocks[pivot], block, blockSize);
+
+    rank++;
+    return true;
+
+}
+
+bool Coder::gaussianElimination(uint8_t *_coeffs, size_t& pivot) 
+{
+
+    if (canDecode()) {
+        return false;
+    }
+
+    memcpy(row, _coeffs, numBlocks);
+    memset(multipliers, 0, numBlocks);
+
+    // Row k of the matrix, if present, has its (unit) pivot in column k, so the
+    // first nonzero column without a row is where the reduced vector pivots.
+    // Gauss-Jordan mode also clears the vector from the pivot columns after that.
+    pivot = numBlocks;
+    for (size_t k = 0; k < numBlocks; k++) {
+
+        uint8_t m = row[k];
+        if (m == 0) {
+            continue;
+        }
+
+        if (coeffs[k][k] == 0) {
+            if (pivot == numBlocks) {
+                pivot = k;
+                if (mode != GAUSS_JORDAN) {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        multipliers[k] = m;
+        gf.subMultiple(m, &row[k], &coeffs[k][k], rowEnds[k] - k);
+
+    }
+
+    if (pivot == numBlocks) {
+        return false;
+    }
+
+    // Normalize so the pivot is 1, and fold the scaling into the block's multipliers
+    uint8_t inverse = gf.div(1, row[pivot]);
+    gf.mul(inverse, multipliers, numBlocks);
+    multipliers[pivot] = inverse;
+
+    size_t end = numBlocks;
+    while (row[end - 1] == 0) {
+        end--;
+    }
+
+    memset(coeffs[pivot], 0, numBlocks);
+    memcpy(&coeffs[pivot][pivot], &row[pivot], end - pivot);
+    gf.mul(inverse, &coeffs[pivot][pivot], end - pivot);
+    rowEnds[pivot] = end;
+
+    rank++;
+    return true;
+
+}
+
+void Coder::rowOperations(uint8_t *block, size_t pivot) 
+{
+
+    // The new block is the received block plus the same multiples of the other
+    // rows that reduced its coefficients (subtraction is addition in characteristic 2)
+    for (size_t k = 0; k < numBlocks; k++) {
+        sources[k] = blocks[k];
+    }
+    sources[pivot] = block;
+
+    gf.linearCombination(blocks[pivot], multipliers, sources, numBlocks, blockSize);
+
 }
 
-void Coder::rowOperations() 
+void Coder::rowOperationsBatch(uint8_t **received, size_t *pivots, uint8_t *batchMultipliers, size_t numReceived)
 {
 
-    if (rank < 2) {
+    if (numReceived == 0) {
         return;
     }
 
-    for (size_t k = 0; k < rank-1; k++) {
+    uint8_t **products = new uint8_t*[numReceived];
+    uint8_t **outputs = new uint8_t*[numReceived];
+    uint8_t *dependencies = new uint8_t[numReceived * numReceived];
+
+    // Rows of this batch are not ready yet, so their multiples are set aside and their
+    // columns refer to the received blocks instead
+    for (size_t k = 0; k < numBlocks; k++) {
+        sources[k] = blocks[k];
+    }
+
+    for (size_t a = 0; a < numReceived; a++) {
+
+        products[a] = &batchMultipliers[a * numBlocks];
+        outputs[a] = blocks[pivots[a]];
+        sources[pivots[a]] = received[a];
 
-        for (size_t i = k+1; i < rank; i++) {
-            gf.addMultiple(coeffs[i][k], blocks[i], blocks[k], blockSize);
+        for (size_t b = 0; b < numReceived; b++) {
+            dependencies[a * numReceived + b] = (b < a) ? products[a][pivots[b]] : 0;
+            if (b != a) {
+                products[a][pivots[b]] = 0;
+            }
         }
     }
 
-    for (size_t i = 0; i < rank; i++) {
-        for (size_t j = 0; j < i; j++) {
-            coeffs[i][j] = 0;
+    // Substituting the earlier rows of the batch on the coefficients costs numBlocks
+    // per dependency instead of blockSize, and leaves a single product to compute
+    for (size_t a = 1; a < numReceived; a++) {
+        gf.addMultiples(products[a], &dependencies[a * numReceived], products, a, numBlocks);
+    }
+
+    gf.matrixProduct(outputs, products, numReceived, sources, numBlocks, blockSize);
+
+    delete [] products;
+    delete [] outputs;
+    delete [] dependencies;
+
+}
+
+void Coder::eliminateColumn(size_t pivot)
+{
+
+    // Rows below the pivot are already zero in its column
+    for (size_t i = 0; i < pivot; i++) {
+
+        uint8_t c = coeffs[i][pivot];
+        if (c == 0) {
+            continue;
         }
+
+        // Records are contiguous and their padding is zero, so one pass covers both halves
+        if (storage) {
+            gf.subMultiple(c, &coeffs[i][pivot], &coeffs[pivot][pivot], stride - pivot);
+        } else {
+            gf.subMultiple(c, &coeffs[i][pivot], &coeffs[pivot][pivot], rowEnds[pivot] - pivot);
+            gf.subMultiple(c, blocks[i], blocks[pivot], blockSize);
+        }
+        rowEnds[i] = std::max(rowEnds[i], rowEnds[pivot]);
     }
 
 }
@@ -310,21 +1016,57 @@ void Coder::rowOperations()
 void Coder::backSubstitution() 
 {
 
-    if (numBlocks == 0) {
+    if (numBlocks < 2) {
         return;
     }
 
-    gf.div(coeffs[numBlocks-1][numBlocks-1], blocks[numBlocks-1], blockSize);
+    // Rows are upper triangular with unit pivots, so each block only needs the
+    // decoded blocks after it subtracted out
+    for (long i = numBlocks-2; i >= 0; i--) {
+        gf.addMultiples(blocks[i], &coeffs[i][i+1], &blocks[i+1], rowEnds[i]-i-1, blockSize);
+    }
+
+}
 
-    if (numBlocks == 1) {
-        return;
+void Coder::applyInverse()
+{
+
+    // Invert the received coefficients into coeffs, which starts as the identity.
+    // Rows are swapped by content, since coefficient rows may be part of records.
+    for (size_t i = 0; i < numBlocks; i++) {
+        memset(coeffs[i], 0, numBlocks);
+        coeffs[i][i] = 1;
     }
 
-    for (long i = numBlocks-2; i >= 0; i--) {
-        for (size_t j = i+1; j < numBlocks; j++) {
-            gf.subMultiple(coeffs[i][j], blocks[i], blocks[j], blockSize);
+    for (size_t k = 0; k < numBlocks; k++) {
+
+        size_t r = k;
+        while (rawCoeffs[r][k] == 0) {
+            r++;
+        }
+        if (r != k) {
+            std::swap_ranges(rawCoeffs[r], rawCoeffs[r] + numBlocks, rawCoeffs[k]);
+            std::swap_ranges(coeffs[r], coeffs[r] + numBlocks, coeffs[k]);
+        }
+
+        uint8_t inverse = gf.div(1, rawCoeffs[k][k]);
+        gf.mul(inverse, &rawCoeffs[k][k], numBlocks - k);
+        gf.mul(inverse, coeffs[k], numBlocks);
+
+        for (size_t i = 0; i < numBlocks; i++) {
+
+            uint8_t c = rawCoeffs[i][k];
+            if (i == k || c == 0) {
+                continue;
+            }
+
+            gf.subMultiple(c, &rawCoeffs[i][k], &rawCoeffs[k][k], numBlocks - k);
+            gf.subMultiple(c, coeffs[i], coeffs[k], numBlocks);
         }
-        gf.div(coeffs[i][i], blocks[i], blockSize);
     }
 
+    // Adopted blocks are read in place and the results written to the block slots
+    gf.transform(blocks, coeffs, heldBlocks(), numBlocks, blockSize);
+    releaseOwned();
+
 }
@@ -7,8 +7,746 @@
 */
 
 #include "gf28.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BLOCKY_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
 
 using namespace blocky;
 
 const uint8_t GF28::AL[512] = {1,3,5,15,17,51,85,255,26,46,114,150,161,248,19,53,95,225,56,72,216,115,149,164,247,2,6,10,30,34,102,170,229,52,92,228,55,89,235,38,106,190,217,112,144,171,230,49,83,245,4,12,20,60,68,204,79,209,104,184,211,110,178,205,76,212,103,169,224,59,77,215,98,166,241,8,24,40,120,136,131,158,185,208,107,189,220,127,129,152,179,206,73,219,118,154,181,196,87,249,16,48,80,240,11,29,39,105,187,214,97,163,254,25,43,125,135,146,173,236,47,113,147,174,233,32,96,160,251,22,58,78,210,109,183,194,93,231,50,86,250,21,63,65,195,94,226,61,71,201,64,192,91,237,44,116,156,191,218,117,159,186,213,100,172,239,42,126,130,157,188,223,122,142,137,128,155,182,193,88,232,35,101,175,234,37,111,177,200,67,197,84,252,31,33,99,165,244,7,9,27,45,119,153,176,203,70,202,69,207,74,222,121,139,134,145,168,227,62,66,198,81,243,14,18,54,90,238,41,123,141,140,143,138,133,148,167,242,13,23,57,75,221,124,132,151,162,253,28,36,108,180,199,82,246,1,3,5,15,17,51,85,255,26,46,114,150,161,248,19,53,95,225,56,72,216,115,149,164,247,2,6,10,30,34,102,170,229,52,92,228,55,89,235,38,106,190,217,112,144,171,230,49,83,245,4,12,20,60,68,204,79,209,104,184,211,110,178,205,76,212,103,169,224,59,77,215,98,166,241,8,24,40,120,136,131,158,185,208,107,189,220,127,129,152,179,206,73,219,118,154,181,196,87,249,16,48,80,240,11,29,39,105,187,214,97,163,254,25,43,125,135,146,173,236,47,113,147,174,233,32,96,160,251,22,58,78,210,109,183,194,93,231,50,86,250,21,63,65,195,94,226,61,71,201,64,192,91,237,44,116,156,191,218,117,159,186,213,100,172,239,42,126,130,157,188,223,122,142,137,128,155,182,193,88,232,35,101,175,234,37,111,177,200,67,197,84,252,31,33,99,165,244,7,9,27,45,119,153,176,203,70,202,69,207,74,222,121,139,134,145,168,227,62,66,198,81,243,14,18,54,90,238,41,123,141,140,143,138,133,148,167,242,13,23,57,75,221,124,132,151,162,253,28,36,108,180,199,82,246,1,0,};
 const uint8_t GF28::L[256] = {0,0,25,1,50,2,26,198,75,199,27,104,51,238,223,3,100,4,224,14,52,141,129,239,76,113,8,200,248,105,28,193,125,194,29,181,249,185,39,106,77,228,166,114,154,201,9,120,101,47,138,5,33,15,225,36,18,240,130,69,53,147,218,142,150,143,219,189,54,208,206,148,19,92,210,241,64,70,131,56,102,221,253,48,191,6,139,98,179,37,226,152,34,136,145,16,126,110,72,195,163,182,30,66,58,107,40,84,250,133,61,186,43,121,10,21,155,159,94,202,78,212,172,229,243,115,167,87,175,88,168,80,244,234,214,116,79,174,233,213,231,230,173,232,44,215,117,122,235,22,11,245,89,203,95,176,156,169,81,160,127,12,246,111,23,196,73,236,216,67,31,45,164,118,123,183,204,187,62,90,251,96,177,134,59,82,161,108,170,85,41,157,151,178,135,144,97,190,220,252,188,149,207,205,55,63,91,209,83,57,132,60,65,162,109,71,20,42,158,93,86,242,211,171,68,17,146,217,35,32,46,137,180,124,184,38,119,153,227,165,103,74,237,222,197,49,254,24,13,99,140,128,192,247,112,7,};
+
+const size_t GF28::TILE_SIZE;
+const size_t GF28::PRODUCT_WIDTH;
+const size_t GF28::STRIPE_THRESHOLD;
+
+GF28::Implementation GF28::implementation = GF28::SCALAR;
+void (*GF28::mulRegion)(uint8_t, uint8_t *, size_t) = &GF28::mulRegionScalar;
+void (*GF28::mulAddRegion)(uint8_t, uint8_t *, const uint8_t *, size_t) = &GF28::mulAddRegionScalar;
+void (*GF28::productRegion)(uint8_t **, uint8_t **, size_t, uint8_t **, size_t, size_t, size_t) = &GF28::productRegionGeneric;
+
+void GF28::mulRegionScalar(uint8_t c, uint8_t *data, size_t size)
+{
+
+    GF28 gf;
+    for (size_t i = 0; i < size; i++) {
+        data[i] = gf.mul(data[i], c);
+    }
+
+}
+
+void GF28::mulAddRegionScalar(uint8_t c, uint8_t *data1, const uint8_t *data2, size_t size)
+{
+
+    GF28 gf;
+    for (size_t i = 0; i < size; i++) {
+        data1[i] = gf.add(data1[i], gf.mul(data2[i], c));
+    }
+
+}
+
+void GF28::productRegionGeneric(uint8_t **outputs, uint8_t **c, size_t m, uint8_t **sources, size_t n, size_t offset, size_t size)
+{
+
+    for (size_t j = 0; j < m; j++) {
+        memset(outputs[j] + offset, 0, size);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < m; j++) {
+            if (c[j][i] != 0) {
+                mulAddRegion(c[j][i], outputs[j] + offset, sources[i] + offset, size);
+            }
+        }
+    }
+
+}
+
+void GF28::linearCombination(uint8_t *data, const uint8_t *c, uint8_t **sources, size_t n, size_t size) const
+{
+
+    forEachStripe(n, size, [&](size_t begin, size_t end) {
+
+        for (size_t offset = begin; offset < end; offset += TILE_SIZE) {
+
+            size_t length = std::min(TILE_SIZE, end - offset);
+            memset(data + offset, 0, length);
+
+            for (size_t i = 0; i < n; i++) {
+                if (c[i] != 0) {
+                    mulAddRegion(c[i], data + offset, sources[i] + offset, length);
+                }
+            }
+        }
+    });
+
+}
+
+void GF28::addMultiples(uint8_t *data, const uint8_t *c, uint8_t **sources, size_t n, size_t size) const
+{
+
+    forEachStripe(n, size, [&](size_t begin, size_t end) {
+
+        for (size_t offset = begin; offset < end; offset += TILE_SIZE) {
+
+            size_t length = std::min(TILE_SIZE, end - offset);
+
+            for (size_t i = 0; i < n; i++) {
+                if (c[i] != 0) {
+                    mulAddRegion(c[i], data + offset, sources[i] + offset, length);
+                }
+            }
+        }
+    });
+
+}
+
+void GF28::matrixProduct(uint8_t **outputs, uint8_t **c, size_t m, uint8_t **sources, size_t n, size_t size) const
+{
+
+    forEachStripe(n, size, [&](size_t begin, size_t end) {
+
+        for (size_t offset = begin; offset < end; offset += TILE_SIZE) {
+
+            size_t length = std::min(TILE_SIZE, end - offset);
+            for (size_t j = 0; j < m; j += PRODUCT_WIDTH) {
+                productRegion(&outputs[j], &c[j], std::min(PRODUCT_WIDTH, m - j), sources, n, offset, length);
+            }
+        }
+    });
+
+}
+
+void GF28::transform(uint8_t **data, uint8_t **c, size_t n, size_t size) const
+{
+    transform(data, c, data, n, size);
+}
+
+void GF28::transform(uint8_t **outputs, uint8_t **c, uint8_t **sources, size_t n, size_t size) const
+{
+
+    // Each stripe keeps its own scratch tiles
+    forEachStripe(n, size, [&](size_t begin, size_t end) {
+
+        uint8_t *scratch = new uint8_t[n * TILE_SIZE];
+        uint8_t **results = new uint8_t*[n];
+        uint8_t **tiles = new uint8_t*[n];
+        for (size_t j = 0; j < n; j++) {
+            results[j] = &scratch[j * TILE_SIZE];
+        }
+
+        for (size_t offset = begin; offset < end; offset += TILE_SIZE) {
+
+            size_t length = std::min(TILE_SIZE, end - offset);
+            for (size_t i = 0; i < n; i++) {
+                tiles[i] = sources[i] + offset;
+            }
+
+            for (size_t j = 0; j < n; j += PRODUCT_WIDTH) {
+                productRegion(&results[j], &c[j], std::min(PRODUCT_WIDTH, n - j), tiles, n, 0, length);
+            }
+
+            for (size_t j = 0; j < n; j++) {
+                memcpy(outputs[j] + offset, results[j], length);
+            }
+        }
+
+        delete [] scratch;
+        delete [] results;
+        delete [] tiles;
+    });
+
+}
+
+void GF28::stripeOnPool(size_t size, const std::function<void(size_t, size_t)>& body) const
+{
+
+    size_t numTiles = (size + TILE_SIZE - 1) / TILE_SIZE;
+    size_t numStripes = std::min(pool->getNumThreads(), numTiles);
+
+    if (numStripes < 2) {
+        body(0, size);
+        return;
+    }
+
+    pool->parallelFor(numStripes, [&](size_t stripe) {
+        size_t begin = ((stripe * numTiles) / numStripes) * TILE_SIZE;
+        size_t end = std::min((((stripe + 1) * numTiles) / numStripes) * TILE_SIZE, size);
+        body(begin, end);
+    });
+
+}
+
+#ifdef BLOCKY_X86
+
+namespace {
+
+/*  Split nibble multiplication tables.
+
+    For a constant c, T[c][i] = c * i and T[c][16 + i] = c * (i << 4), so that
+    c * x = T[c][x & 0xf] ^ T[c][16 + (x >> 4)]. Each half fits in one PSHUFB lookup.
+*/
+alignas(64) uint8_t nibbleTables[256][32];
+
+void buildNibbleTables()
+{
+
+    GF28 gf;
+    for (size_t c = 0; c < 256; c++) {
+        for (size_t i = 0; i < 16; i++) {
+            nibbleTables[c][i] = gf.mul(c, i);
+            nibbleTables[c][16 + i] = gf.mul(c, i << 4);
+        }
+    }
+
+}
+
+inline uint8_t mulNibbles(const uint8_t *table, uint8_t x)
+{
+    return table[x & 0xf] ^ table[16 + (x >> 4)];
+}
+
+__attribute__((target("ssse3")))
+void mulRegionSSSE3(uint8_t c, uint8_t *data, size_t size)
+{
+
+    const uint8_t *table = nibbleTables[c];
+    const __m128i lo = _mm_load_si128((const __m128i *) table);
+    const __m128i hi = _mm_load_si128((const __m128i *) (table + 16));
+    const __m128i mask = _mm_set1_epi8(0xf);
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(x, mask));
+        __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+        _mm_storeu_si128((__m128i *) (data + i), _mm_xor_si128(l, h));
+    }
+
+    for (; i < size; i++) {
+        data[i] = mulNibbles(table, data[i]);
+    }
+
+}
+
+__attribute__((target("ssse3")))
+void mulAddRegionSSSE3(uint8_t c, uint8_t *data1, const uint8_t *data2, size_t size)
+{
+
+    const uint8_t *table = nibbleTables[c];
+    const __m128i lo = _mm_load_si128((const __m128i *) table);
+    const __m128i hi = _mm_load_si128((const __m128i *) (table + 16));
+    const __m128i mask = _mm_set1_epi8(0xf);
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (data2 + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (data1 + i));
+        __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(x, mask));
+        __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+        _mm_storeu_si128((__m128i *) (data1 + i), _mm_xor_si128(y, _mm_xor_si128(l, h)));
+    }
+
+    for (; i < size; i++) {
+        data1[i] ^= mulNibbles(table, data2[i]);
+    }
+
+}
+
+__attribute__((target("avx2")))
+void mulRegionAVX2(uint8_t c, uint8_t *data, size_t size)
+{
+
+    const uint8_t *table = nibbleTables[c];
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) table));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) (table + 16)));
+    const __m256i mask = _mm256_set1_epi8(0xf);
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask));
+        __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+        _mm256_storeu_si256((__m256i *) (data + i), _mm256_xor_si256(l, h));
+    }
+
+    for (; i < size; i++) {
+        data[i] = mulNibbles(table, data[i]);
+    }
+
+}
+
+__attribute__((target("avx2")))
+void mulAddRegionAVX2(uint8_t c, uint8_t *data1, const uint8_t *data2, size_t size)
+{
+
+    const uint8_t *table = nibbleTables[c];
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) table));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) (table + 16)));
+    const __m256i mask = _mm256_set1_epi8(0xf);
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (data2 + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (data1 + i));
+        __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask));
+        __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+        _mm256_storeu_si256((__m256i *) (data1 + i), _mm256_xor_si256(y, _mm256_xor_si256(l, h)));
+    }
+
+    for (; i < size; i++) {
+        data1[i] ^= mulNibbles(table, data2[i]);
+    }
+
+}
+
+// Some GCC versions warn about _mm512_undefined_epi32() inside their own intrinsics headers
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f,avx512bw")))
+void mulRegionAVX512(uint8_t c, uint8_t *data, size_t size)
+{
+
+    const uint8_t *table = nibbleTables[c];
+    const __m512i lo = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) table));
+    const __m512i hi = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) (table + 16)));
+    const __m512i mask = _mm512_set1_epi8(0xf);
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void *) (data + i));
+        __m512i l = _mm512_shuffle_epi8(lo, _mm512_and_si512(x, mask));
+        __m512i h = _mm512_shuffle_epi8(hi, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask));
+        _mm512_storeu_si512((void *) (data + i), _mm512_xor_si512(l, h));
+    }
+
+    if (i < size) {
+        __mmask64 tail = (1ULL << (size - i)) - 1;
+        __m512i x = _mm512_maskz_loadu_epi8(tail, data + i);
+        __m512i l = _mm512_shuffle_epi8(lo, _mm512_and_si512(x, mask));
+        __m512i h = _mm512_shuffle_epi8(hi, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask));
+        _mm512_mask_storeu_epi8(data + i, tail, _mm512_xor_si512(l, h));
+    }
+
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void mulAddRegionAVX512(uint8_t c, uint8_t *data1, const uint8_t *data2, size_t size)
+{
+
+    const uint8_t *table = nibbleTables[c];
+    const __m512i lo = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) table));
+    const __m512i hi = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) (table + 16)));
+    const __m512i mask = _mm512_set1_epi8(0xf);
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void *) (data2 + i));
+        __m512i y = _mm512_loadu_si512((const void *) (data1 + i));
+        __m512i l = _mm512_shuffle_epi8(lo, _mm512_and_si512(x, mask));
+        __m512i h = _mm512_shuffle_epi8(hi, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask));
+        _mm512_storeu_si512((void *) (data1 + i), _mm512_xor_si512(y, _mm512_xor_si512(l, h)));
+    }
+
+    if (i < size) {
+        __mmask64 tail = (1ULL << (size - i)) - 1;
+        __m512i x = _mm512_maskz_loadu_epi8(tail, data2 + i);
+        __m512i y = _mm512_maskz_loadu_epi8(tail, data1 + i);
+        __m512i l = _mm512_shuffle_epi8(lo, _mm512_and_si512(x, mask));
+        __m512i h = _mm512_shuffle_epi8(hi, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask));
+        _mm512_mask_storeu_epi8(data1 + i, tail, _mm512_xor_si512(y, _mm512_xor_si512(l, h)));
+    }
+
+}
+
+// GFNI multiplies modulo x^8 + x^4 + x^3 + x + 1, the same polynomial as the log tables
+
+__attribute__((target("gfni,avx2")))
+void mulRegionGFNIAVX2(uint8_t c, uint8_t *data, size_t size)
+{
+
+    const __m256i k = _mm256_set1_epi8(c);
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (data + i));
+        _mm256_storeu_si256((__m256i *) (data + i), _mm256_gf2p8mul_epi8(x, k));
+    }
+
+    const uint8_t *table = nibbleTables[c];
+    for (; i < size; i++) {
+        data[i] = mulNibbles(table, data[i]);
+    }
+
+}
+
+__attribute__((target("gfni,avx2")))
+void mulAddRegionGFNIAVX2(uint8_t c, uint8_t *data1, const uint8_t *data2, size_t size)
+{
+
+    const __m256i k = _mm256_set1_epi8(c);
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (data2 + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (data1 + i));
+        _mm256_storeu_si256((__m256i *) (data1 + i), _mm256_xor_si256(y, _mm256_gf2p8mul_epi8(x, k)));
+    }
+
+    const uint8_t *table = nibbleTables[c];
+    for (; i < size; i++) {
+        data1[i] ^= mulNibbles(table, data2[i]);
+    }
+
+}
+
+__attribute__((target("gfni,avx512f,avx512bw")))
+void mulRegionGFNIAVX512(uint8_t c, uint8_t *data, size_t size)
+{
+
+    const __m512i k = _mm512_set1_epi8(c);
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void *) (data + i));
+        _mm512_storeu_si512((void *) (data + i), _mm512_gf2p8mul_epi8(x, k));
+    }
+
+    // Short rows (coefficient vectors) are common, so the tail is masked rather than scalar
+    if (i < size) {
+        __mmask64 tail = (1ULL << (size - i)) - 1;
+        __m512i x = _mm512_maskz_loadu_epi8(tail, data + i);
+        _mm512_mask_storeu_epi8(data + i, tail, _mm512_gf2p8mul_epi8(x, k));
+    }
+
+}
+
+__attribute__((target("gfni,avx512f,avx512bw")))
+void mulAddRegionGFNIAVX512(uint8_t c, uint8_t *data1, const uint8_t *data2, size_t size)
+{
+
+    const __m512i k = _mm512_set1_epi8(c);
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void *) (data2 + i));
+        __m512i y = _mm512_loadu_si512((const void *) (data1 + i));
+        _mm512_storeu_si512((void *) (data1 + i), _mm512_xor_si512(y, _mm512_gf2p8mul_epi8(x, k)));
+    }
+
+    if (i < size) {
+        __mmask64 tail = (1ULL << (size - i)) - 1;
+        __m512i x = _mm512_maskz_loadu_epi8(tail, data2 + i);
+        __m512i y = _mm512_maskz_loadu_epi8(tail, data1 + i);
+        _mm512_mask_storeu_epi8(data1 + i, tail, _mm512_xor_si512(y, _mm512_gf2p8mul_epi8(x, k)));
+    }
+
+}
+
+/*  Finishes a product region that is too short for the vector loops */
+void productTail(uint8_t **outputs, uint8_t **c, size_t m, uint8_t **sources, size_t n, size_t offset, size_t size,
+                 void (*mulAdd)(uint8_t, uint8_t *, const uint8_t *, size_t))
+{
+
+    for (size_t j = 0; j < m; j++) {
+        memset(outputs[j] + offset, 0, size);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < m; j++) {
+            if (c[j][i] != 0) {
+                mulAdd(c[j][i], outputs[j] + offset, sources[i] + offset, size);
+            }
+        }
+    }
+
+}
+
+/*  The product kernels below compute four outputs at a time (GF28::PRODUCT_WIDTH) over
+    a few vectors of the region, keeping the sums in registers while each source is
+    loaded once. Missing outputs get zero constants and are not stored. */
+
+__attribute__((target("gfni,avx2")))
+void productRegionGFNIAVX2(uint8_t **outputs, uint8_t **c, size_t m, uint8_t **sources, size_t n, size_t offset, size_t size)
+{
+
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+
+        __m256i acc[4][2];
+        for (size_t j = 0; j < 4; j++) {
+            acc[j][0] = acc[j][1] = _mm256_setzero_si256();
+        }
+
+        for (size_t s = 0; s < n; s++) {
+
+            uint8_t k[4];
+            for (size_t j = 0; j < 4; j++) {
+                k[j] = (j < m) ? c[j][s] : 0;
+            }
+            if ((k[0] | k[1] | k[2] | k[3]) == 0) {
+                continue;
+            }
+
+            const uint8_t *source = sources[s] + offset + i;
+            __m256i x0 = _mm256_loadu_si256((const __m256i *) source);
+            __m256i x1 = _mm256_loadu_si256((const __m256i *) (source + 32));
+            for (size_t j = 0; j < 4; j++) {
+                __m256i kj = _mm256_set1_epi8(k[j]);
+                acc[j][0] = _mm256_xor_si256(acc[j][0], _mm256_gf2p8mul_epi8(x0, kj));
+                acc[j][1] = _mm256_xor_si256(acc[j][1], _mm256_gf2p8mul_epi8(x1, kj));
+            }
+        }
+
+        for (size_t j = 0; j < m; j++) {
+            _mm256_storeu_si256((__m256i *) (outputs[j] + offset + i), acc[j][0]);
+            _mm256_storeu_si256((__m256i *) (outputs[j] + offset + i + 32), acc[j][1]);
+        }
+    }
+
+    productTail(outputs, c, m, sources, n, offset + i, size - i, &mulAddRegionGFNIAVX2);
+
+}
+
+__attribute__((target("gfni,avx512f,avx512bw")))
+void productRegionGFNIAVX512(uint8_t **outputs, uint8_t **c, size_t m, uint8_t **sources, size_t n, size_t offset, size_t size)
+{
+
+    size_t i = 0;
+    for (; i + 256 <= size; i += 256) {
+
+        __m512i acc[4][4];
+        for (size_t j = 0; j < 4; j++) {
+            for (size_t v = 0; v < 4; v++) {
+                acc[j][v] = _mm512_setzero_si512();
+            }
+        }
+
+        for (size_t s = 0; s < n; s++) {
+
+            uint8_t k[4];
+            for (size_t j = 0; j < 4; j++) {
+                k[j] = (j < m) ? c[j][s] : 0;
+            }
+            if ((k[0] | k[1] | k[2] | k[3]) == 0) {
+                continue;
+            }
+
+            const uint8_t *source = sources[s] + offset + i;
+            __m512i x[4];
+            for (size_t v = 0; v < 4; v++) {
+                x[v] = _mm512_loadu_si512((const void *) (source + 64 * v));
+            }
+            for (size_t j = 0; j < 4; j++) {
+                __m512i kj = _mm512_set1_epi8(k[j]);
+                for (size_t v = 0; v < 4; v++) {
+                    acc[j][v] = _mm512_xor_si512(acc[j][v], _mm512_gf2p8mul_epi8(x[v], kj));
+                }
+            }
+        }
+
+        for (size_t j = 0; j < m; j++) {
+            for (size_t v = 0; v < 4; v++) {
+                _mm512_storeu_si512((void *) (outputs[j] + offset + i + 64 * v), acc[j][v]);
+            }
+        }
+    }
+
+    productTail(outputs, c, m, sources, n, offset + i, size - i, &mulAddRegionGFNIAVX512);
+
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+/*  CPU features relevant to the bulk operations */
+struct CPUFeatures {
+    bool ssse3;
+    bool avx2;
+    bool avx512;
+    bool gfni;
+};
+
+uint64_t xgetbv()
+{
+
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t) edx << 32) | eax;
+
+}
+
+CPUFeatures detectCPUFeatures()
+{
+
+    CPUFeatures features = {false, false, false, false};
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return features;
+    }
+
+    features.ssse3 = (ecx & bit_SSSE3) != 0;
+
+    // AVX state must be enabled by the OS as well as supported by the CPU
+    bool osxsave = (ecx & bit_OSXSAVE) != 0;
+    bool avx = (ecx & bit_AVX) != 0;
+    if (!osxsave || !avx) {
+        return features;
+    }
+
+    uint64_t xcr0 = xgetbv();
+    bool ymm = (xcr0 & 0x6) == 0x6;
+    bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return features;
+    }
+
+    features.avx2 = ymm && (ebx & bit_AVX2) != 0;
+    features.avx512 = zmm && (ebx & bit_AVX512F) != 0 && (ebx & bit_AVX512BW) != 0;
+    features.gfni = ymm && (ecx & bit_GFNI) != 0;
+
+    return features;
+
+}
+
+const CPUFeatures cpuFeatures = detectCPUFeatures();
+
+}
+
+#endif
+
+bool GF28::isSupported(Implementation impl)
+{
+
+    switch (impl) {
+    case SCALAR:
+        return true;
+#ifdef BLOCKY_X86
+    case SSSE3:
+        return cpuFeatures.ssse3;
+    case AVX2:
+        return cpuFeatures.avx2;
+    case AVX512:
+        return cpuFeatures.avx512;
+    case GFNI_AVX2:
+        return cpuFeatures.gfni && cpuFeatures.avx2;
+    case GFNI_AVX512:
+        return cpuFeatures.gfni && cpuFeatures.avx512;
+#endif
+    default:
+        return false;
+    }
+
+}
+
+GF28::Implementation GF28::getBestImplementation()
+{
+
+    const Implementation order[] = {GFNI_AVX512, GFNI_AVX2, AVX512, AVX2, SSSE3};
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        if (isSupported(order[i])) {
+            return order[i];
+        }
+    }
+    return SCALAR;
+
+}
+
+bool GF28::setImplementation(Implementation impl)
+{
+
+    if (!isSupported(impl)) {
+        return false;
+    }
+
+    switch (impl) {
+#ifdef BLOCKY_X86
+    case SSSE3:
+        mulRegion = &mulRegionSSSE3;
+        mulAddRegion = &mulAddRegionSSSE3;
+        productRegion = &productRegionGeneric;
+        break;
+    case AVX2:
+        mulRegion = &mulRegionAVX2;
+        mulAddRegion = &mulAddRegionAVX2;
+        productRegion = &productRegionGeneric;
+        break;
+    case AVX512:
+        mulRegion = &mulRegionAVX512;
+        mulAddRegion = &mulAddRegionAVX512;
+        productRegion = &productRegionGeneric;
+        break;
+    case GFNI_AVX2:
+        mulRegion = &mulRegionGFNIAVX2;
+        mulAddRegion = &mulAddRegionGFNIAVX2;
+        productRegion = &productRegionGFNIAVX2;
+        break;
+    case GFNI_AVX512:
+        mulRegion = &mulRegionGFNIAVX512;
+        mulAddRegion = &mulAddRegionGFNIAVX512;
+        productRegion = &productRegionGFNIAVX512;
+        break;
+#endif
+    default:
+        mulRegion = &mulRegionScalar;
+        mulAddRegion = &mulAddRegionScalar;
+        productRegion = &productRegionGeneric;
+        break;
+    }
+
+    implementation = impl;
+    return true;
+
+}
+
+const char *GF28::getImplementationName(Implementation impl)
+{
+
+    switch (impl) {
+    case SCALAR:
+        return "scalar";
+    case SSSE3:
+        return "ssse3";
+    case AVX2:
+        return "avx2";
+    case AVX512:
+        return "avx512";
+    case GFNI_AVX2:
+        return "gfni-avx2";
+    case GFNI_AVX512:
+        return "gfni-avx512";
+    default:
+        return "unknown";
+    }
+
+}
+
+namespace {
+
+/*  Selects the fastest implementation once, at startup */
+struct GF28Initializer {
+    GF28Initializer()
+    {
+#ifdef BLOCKY_X86
+        buildNibbleTables();
+#endif
+        GF28::setImplementation(GF28::getBestImplementation());
+    }
+};
+
+const GF28Initializer initializer;
+
+}
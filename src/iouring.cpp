@@ -0,0 +1,424 @@
+/*!
+    @file
+    @brief IoUring
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#include "iouring.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define BLOCKY_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#endif
+
+using namespace blocky;
+
+#ifdef BLOCKY_IO_URING
+
+namespace {
+
+int ioUringSetup(unsigned entries, io_uring_params *params)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned numArgs)
+{
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, numArgs);
+}
+
+}
+
+#endif
+
+IoUring::IoUring() :
+    ringFd(-1),
+    entries(0),
+    pending(0),
+    sqRing(NULL),
+    sqRingSize(0),
+    cqRing(NULL),
+    cqRingSize(0),
+    sqes(NULL),
+    sqTail(NULL),
+    sqMask(0),
+    sqArray(NULL),
+    cqHead(NULL),
+    cqTail(NULL),
+    cqMask(0),
+    cqes(NULL),
+    fixedBuffer(NULL),
+    fixedLength(0)
+{
+
+}
+
+IoUring::IoUring(unsigned _entries)
+    : IoUring()
+{
+
+#ifdef BLOCKY_IO_URING
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = ioUringSetup(_entries, &params);
+    if (ringFd < 0) {
+        ringFd = -1;
+        return;
+    }
+
+    entries = params.sq_entries;
+    sqRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+    cqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = NULL;
+        release();
+        return;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = NULL;
+            release();
+            return;
+        }
+    }
+
+    sqes = mmap(NULL, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        sqes = NULL;
+        release();
+        return;
+    }
+
+    uint8_t *sq = (uint8_t *) sqRing;
+    sqTail = (unsigned *) &sq[params.sq_off.tail];
+    sqMask = *(unsigned *) &sq[params.sq_off.ring_mask];
+    sqArray = (unsigned *) &sq[params.sq_off.array];
+
+    uint8_t *cq = (uint8_t *) cqRing;
+    cqHead = (unsigned *) &cq[params.cq_off.head];
+    cqTail = (unsigned *) &cq[params.cq_off.tail];
+    cqMask = *(unsigned *) &cq[params.cq_off.ring_mask];
+    cqes = &cq[params.cq_off.cqes];
+#else
+    (void) _entries;
+#endif
+
+}
+
+IoUring::IoUring(IoUring&& other)
+    : IoUring()
+{
+
+    swap(*this, other);
+
+}
+
+IoUring::~IoUring()
+{
+
+    uint64_t tag;
+    int result;
+    while (wait(tag, result)) {
+    }
+
+    release();
+
+}
+
+IoUring& IoUring::operator =(IoUring& other)
+{
+
+    swap(*this, other);
+    return *this;
+
+}
+
+IoUring& IoUring::operator =(IoUring&& other)
+{
+
+    swap(*this, other);
+    return *this;
+
+}
+
+void IoUring::swap(IoUring& first, IoUring& second)
+{
+
+    using std::swap;
+    swap(first.ringFd, second.ringFd);
+    swap(first.entries, second.entries);
+    swap(first.pending, second.pending);
+    swap(first.sqRing, second.sqRing);
+    swap(first.sqRingSize, second.sqRingSize);
+    swap(first.cqRing, second.cqRing);
+    swap(first.cqRingSize, second.cqRingSize);
+    swap(first.sqes, second.sqes);
+    swap(first.sqTail, second.sqTail);
+    swap(first.sqMask, second.sqMask);
+    swap(first.sqArray, second.sqArray);
+    swap(first.cqHead, second.cqHead);
+    swap(first.cqTail, second.cqTail);
+    swap(first.cqMask, second.cqMask);
+    swap(first.cqes, second.cqes);
+    swap(first.fixedBuffer, second.fixedBuffer);
+    swap(first.fixedLength, second.fixedLength);
+
+}
+
+void IoUring::release()
+{
+
+#ifdef BLOCKY_IO_URING
+    if (sqes) {
+        munmap(sqes, entries * sizeof(io_uring_sqe));
+    }
+
+    if (cqRing && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+
+    if (sqRing) {
+        munmap(sqRing, sqRingSize);
+    }
+
+    if (ringFd >= 0) {
+        close(ringFd);
+    }
+#endif
+
+    ringFd = -1;
+    sqRing = cqRing = sqes = cqes = NULL;
+    fixedBuffer = NULL;
+    fixedLength = 0;
+
+}
+
+bool IoUring::isSupported()
+{
+
+    static const bool supported = probe();
+    return supported;
+
+}
+
+bool IoUring::probe()
+{
+
+#ifdef BLOCKY_IO_URING
+    IoUring ring(1);
+    if (!ring.getAvailable()) {
+        return false;
+    }
+
+    // Plain reads and writes came after the ring itself; the probe came with them, so a
+    // kernel without the probe can't do them either
+    size_t numOps = 256;
+    uint8_t *storage = new uint8_t[sizeof(io_uring_probe) + (numOps * sizeof(io_uring_probe_op))]();
+    io_uring_probe *probed = (io_uring_probe *) storage;
+    bool supported = ioUringRegister(ring.ringFd, IORING_REGISTER_PROBE, probed, numOps) >= 0;
+    for (uint8_t op : { (uint8_t) IORING_OP_READ, (uint8_t) IORING_OP_WRITE }) {
+        if (op >= probed->ops_len || !(probed->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            supported = false;
+        }
+    }
+
+    delete [] storage;
+    return supported;
+#else
+    return false;
+#endif
+
+}
+
+size_t IoUring::getRunning()
+{
+
+#ifdef BLOCKY_IO_URING
+    if (ringFd < 0) {
+        return 0;
+    }
+
+    unsigned completed = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) - *cqHead;
+    return pending - completed;
+#else
+    return 0;
+#endif
+
+}
+
+bool IoUring::registerBuffer(uint8_t *data, size_t length)
+{
+
+#ifdef BLOCKY_IO_URING
+    if (ringFd < 0 || fixedBuffer != NULL) {
+        return false;
+    }
+
+    iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = length;
+    if (ioUringRegister(ringFd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+        return false;
+    }
+
+    fixedBuffer = data;
+    fixedLength = length;
+    return true;
+#else
+    (void) data;
+    (void) length;
+    return false;
+#endif
+
+}
+
+bool IoUring::submitRead(int fd, uint8_t *data, size_t length, size_t offset, uint64_t tag)
+{
+
+#ifdef BLOCKY_IO_URING
+    return submit(IORING_OP_READ, fd, data, length, offset, tag);
+#else
+    return submit(0, fd, data, length, offset, tag);
+#endif
+
+}
+
+bool IoUring::submitWrite(int fd, const uint8_t *data, size_t length, size_t offset, uint64_t tag)
+{
+
+#ifdef BLOCKY_IO_URING
+    return submit(IORING_OP_WRITE, fd, data, length, offset, tag);
+#else
+    return submit(0, fd, data, length, offset, tag);
+#endif
+
+}
+
+bool IoUring::submit(uint8_t opcode, int fd, const uint8_t *data, size_t length, size_t offset, uint64_t tag)
+{
+
+#ifdef BLOCKY_IO_URING
+    if (ringFd < 0 || pending >= entries) {
+        return false;
+    }
+
+    // Requests inside the registered buffer use it, which skips mapping the pages
+    bool fixed = fixedBuffer != NULL && data >= fixedBuffer && data + length <= fixedBuffer + fixedLength;
+
+    unsigned tail = *sqTail;
+    unsigned index = tail & sqMask;
+    io_uring_sqe *sqe = &((io_uring_sqe *) sqes)[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    if (fixed) {
+        sqe->opcode = opcode == IORING_OP_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+    }
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = (uint64_t) (uintptr_t) data;
+    sqe->len = (uint32_t) length;
+    sqe->user_data = tag;
+    sqe->buf_index = 0;
+    sqArray[index] = index;
+
+    // The kernel must see the entry before the tail moves past it
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    if (ioUringEnter(ringFd, 1, 0, 0) < 1) {
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    pending++;
+    return true;
+#else
+    (void) opcode;
+    (void) fd;
+    (void) data;
+    (void) length;
+    (void) offset;
+    (void) tag;
+    return false;
+#endif
+
+}
+
+bool IoUring::poll(uint64_t& tag, int& result)
+{
+
+#ifdef BLOCKY_IO_URING
+    if (ringFd < 0 || pending == 0) {
+        return false;
+    }
+
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    io_uring_cqe *cqe = &((io_uring_cqe *) cqes)[head & cqMask];
+    tag = cqe->user_data;
+    result = cqe->res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+    pending--;
+    return true;
+#else
+    (void) tag;
+    (void) result;
+    return false;
+#endif
+
+}
+
+bool IoUring::wait(uint64_t& tag, int& result)
+{
+
+#ifdef BLOCKY_IO_URING
+    while (pending > 0) {
+
+        if (poll(tag, result)) {
+            return true;
+        }
+
+        // Giving up would let the caller free buffers the kernel still uses, so a failed
+        // wait (say, EAGAIN or EBUSY under memory pressure) backs off and tries again
+        if (ioUringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+#else
+    (void) tag;
+    (void) result;
+#endif
+
+    return false;
+
+}
@@ -0,0 +1,175 @@
+/*!
+    @file
+    @brief RankTracker
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#include <algorithm>
+#include "ranktracker.h"
+
+using namespace blocky;
+
+RankTracker::RankTracker() :
+    numBlocks(0),
+    rank(0),
+    matrix(NULL),
+    row(NULL)
+{
+
+}
+
+RankTracker::RankTracker(size_t _numBlocks) :
+    numBlocks(_numBlocks),
+    rank(0),
+    matrix(new uint8_t[_numBlocks * (_numBlocks + 1)]),
+    row(&matrix[_numBlocks * _numBlocks])
+{
+
+    memset(matrix, 0, numBlocks * numBlocks);
+
+}
+
+RankTracker::RankTracker(const RankTracker& other) :
+    numBlocks(other.numBlocks),
+    rank(other.rank),
+    matrix(NULL),
+    row(NULL)
+{
+
+    if (other.matrix) {
+        matrix = new uint8_t[numBlocks * (numBlocks + 1)];
+        row = &matrix[numBlocks * numBlocks];
+        memcpy(matrix, other.matrix, numBlocks * numBlocks);
+    }
+
+}
+
+RankTracker::RankTracker(RankTracker&& other)
+    : RankTracker()
+{
+
+    swap(*this, other);
+
+}
+
+RankTracker::~RankTracker()
+{
+
+    if (matrix) {
+        delete [] matrix;
+    }
+
+}
+
+RankTracker& RankTracker::operator =(RankTracker& other)
+{
+
+    swap(*this, other);
+    return *this;
+
+}
+
+RankTracker& RankTracker::operator =(RankTracker&& other)
+{
+
+    swap(*this, other);
+    return *this;
+
+}
+
+void RankTracker::swap(RankTracker& first, RankTracker& second)
+{
+
+    using std::swap;
+
+    swap(first.numBlocks, second.numBlocks);
+    swap(first.rank, second.rank);
+    swap(first.matrix, second.matrix);
+    swap(first.row, second.row);
+
+}
+
+size_t RankTracker::reduceRow()
+{
+
+    for (size_t k = 0; k < numBlocks; k++) {
+
+        uint8_t m = row[k];
+        if (m == 0) {
+            continue;
+        }
+
+        uint8_t *pivotRow = &matrix[k * numBlocks];
+        if (pivotRow[k] == 0) {
+            return k;
+        }
+
+        gf.subMultiple(m, &row[k], &pivotRow[k], numBlocks - k);
+    }
+
+    return numBlocks;
+
+}
+
+bool RankTracker::storeRow()
+{
+
+    if (rank == numBlocks) {
+        return false;
+    }
+
+    size_t pivot = reduceRow();
+    if (pivot == numBlocks) {
+        return false;
+    }
+
+    // Entries before the pivot are already zero
+    uint8_t *pivotRow = &matrix[pivot * numBlocks];
+    memcpy(&pivotRow[pivot], &row[pivot], numBlocks - pivot);
+    gf.mul(gf.div(1, row[pivot]), &pivotRow[pivot], numBlocks - pivot);
+
+    rank++;
+    return true;
+
+}
+
+bool RankTracker::isInnovative(const uint8_t *coeffs)
+{
+
+    if (rank == numBlocks) {
+        return false;
+    }
+
+    memcpy(row, coeffs, numBlocks);
+    return reduceRow() != numBlocks;
+
+}
+
+bool RankTracker::store(const uint8_t *coeffs)
+{
+
+    memcpy(row, coeffs, numBlocks);
+    return storeRow();
+
+}
+
+bool RankTracker::storeSeeded(uint32_t seed)
+{
+
+    PRNG expander(seed);
+    expander.nonzeroBytes(row, numBlocks);
+    return storeRow();
+
+}
+
+void RankTracker::reset()
+{
+
+    if (matrix) {
+        memset(matrix, 0, numBlocks * numBlocks);
+    }
+    rank = 0;
+
+}
@@ -0,0 +1,189 @@
+/*!
+    @file
+    @brief ThreadPool
+    @author Hasnain Lakhani
+    @date 2014
+    @copyright (c) 2014, see LICENSE for details
+*/
+
+#include "threadpool.h"
+
+using namespace blocky;
+using namespace std;
+
+namespace {
+
+// Whether this thread is already running iterations of a loop
+thread_local bool insideLoop = false;
+
+}
+
+ThreadPool::Job::Job(const function<void(size_t)>& _body, size_t count, size_t _numRanges) :
+    body(_body),
+    ranges(new Range[_numRanges]),
+    numRanges(_numRanges),
+    active(0)
+{
+
+    for (size_t i = 0; i < numRanges; i++) {
+        ranges[i].next = (i * count) / numRanges;
+        ranges[i].end = ((i + 1) * count) / numRanges;
+    }
+
+}
+
+ThreadPool::Job::~Job()
+{
+
+    delete [] ranges;
+
+}
+
+ThreadPool::ThreadPool() :
+    current(NULL),
+    serial(0),
+    stopping(false)
+{
+
+    start(thread::hardware_concurrency());
+
+}
+
+ThreadPool::ThreadPool(size_t _numThreads) :
+    current(NULL),
+    serial(0),
+    stopping(false)
+{
+
+    start(_numThreads);
+
+}
+
+ThreadPool::~ThreadPool()
+{
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+}
+
+ThreadPool& ThreadPool::getDefault()
+{
+
+    static ThreadPool pool;
+    return pool;
+
+}
+
+void ThreadPool::start(size_t _numThreads)
+{
+
+    // The caller is one of the threads
+    for (size_t i = 1; i < _numThreads; i++) {
+        workers.push_back(thread(&ThreadPool::work, this, i));
+    }
+
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& body)
+{
+
+    if (workers.empty() || count < 2 || insideLoop) {
+
+        Job job(body, count, 1);
+        run(job, 0);
+        if (job.error) {
+            rethrow_exception(job.error);
+        }
+        return;
+    }
+
+    lock_guard<std::mutex> submitLock(submitMutex);
+    Job job(body, count, getNumThreads());
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        current = &job;
+        serial++;
+    }
+    wake.notify_all();
+
+    run(job, 0);
+
+    // Nothing is left to claim; wait for iterations still running elsewhere
+    {
+        unique_lock<std::mutex> lock(mutex);
+        current = NULL;
+        done.wait(lock, [&job] { return job.active == 0; });
+    }
+
+    if (job.error) {
+        rethrow_exception(job.error);
+    }
+
+}
+
+void ThreadPool::work(size_t index)
+{
+
+    size_t seen = 0;
+    for (;;) {
+
+        Job *job;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return stopping || (current != NULL && serial != seen); });
+            if (stopping) {
+                return;
+            }
+
+            seen = serial;
+            job = current;
+            job->active++;
+        }
+
+        run(*job, index);
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            if (--job->active == 0) {
+                done.notify_all();
+            }
+        }
+    }
+
+}
+
+void ThreadPool::run(Job& job, size_t index)
+{
+
+    bool outer = insideLoop;
+    insideLoop = true;
+
+    // Drain our own share first, then steal from the others in turn
+    for (size_t r = 0; r < job.numRanges; r++) {
+
+        Range& range = job.ranges[(index + r) % job.numRanges];
+        for (size_t i = range.next++; i < range.end; i = range.next++) {
+
+            try {
+                job.body(i);
+            } catch (...) {
+                lock_guard<std::mutex> lock(job.errorMutex);
+                if (!job.error) {
+                    job.error = current_exception();
+                }
+            }
+        }
+    }
+
+    insideLoop = outer;
+
+}